@@ -0,0 +1,110 @@
+// IWYU pragma: always_keep // See pybind11/docs/type_caster_iwyu.rst
+
+#ifndef PYBIND11_PROTOBUF_ARENA_OWNED_H_
+#define PYBIND11_PROTOBUF_ARENA_OWNED_H_
+
+#include <pybind11/cast.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/pytypes.h>
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "google/protobuf/arena.h"
+#include "google/protobuf/message.h"
+#include "pybind11_protobuf/proto_cast_util.h"
+
+// ArenaOwned<T> returns a message allocated on a ::google::protobuf::Arena to
+// Python without copying it. The result is a FrozenMessage (see
+// DefineFrozenProtos) which keeps the arena alive; passing it to C++
+// functions taking the message uses the arena message directly. Its fields
+// are read from the arena message, and its .message property converts it to
+// a Python message on first use. The arena is destroyed when the last
+// FrozenMessage referencing it, or one of its submessages, is collected.
+//
+// Example:
+//
+// #include "pybind11_protobuf/arena_owned.h"
+//
+// PYBIND11_MODULE(my_module, m) {
+//   pybind11_protobuf::ImportNativeProtoCasters();
+//
+//   m.def("build", [](int n) {
+//     auto arena = std::make_shared<google::protobuf::Arena>();
+//     auto* result = google::protobuf::Arena::Create<MyResult>(arena.get());
+//     Build(n, result);
+//     return pybind11_protobuf::ArenaOwned<MyResult>(std::move(arena), result);
+//   });
+// }
+
+namespace pybind11_protobuf {
+
+/// A message and the arena it was allocated on. The message must not be
+/// modified once it has been returned to Python.
+template <typename ProtoType>
+class ArenaOwned {
+  static_assert(std::is_base_of<::google::protobuf::Message, ProtoType>::value,
+                "ArenaOwned requires a ::google::protobuf::Message type");
+
+ public:
+  ArenaOwned() = default;
+  ArenaOwned(std::shared_ptr<::google::protobuf::Arena> arena,
+             ProtoType* message)
+      : arena_(std::move(arena)), message_(message) {}
+
+  ProtoType* get() const { return message_; }
+  ProtoType& operator*() const { return *message_; }
+  ProtoType* operator->() const { return message_; }
+
+  const std::shared_ptr<::google::protobuf::Arena>& arena() const {
+    return arena_;
+  }
+
+  /// Returns a pointer to the message sharing ownership of the arena.
+  std::shared_ptr<const ProtoType> share() const {
+    return std::shared_ptr<const ProtoType>(arena_, message_);
+  }
+
+ private:
+  std::shared_ptr<::google::protobuf::Arena> arena_;
+  ProtoType* message_ = nullptr;
+};
+
+// type_caster<> implementation for ArenaOwned<T>, which only converts from
+// C++ to Python.
+template <typename ProtoType>
+struct arena_owned_caster {
+  static constexpr auto name = pybind11::detail::const_name("FrozenMessage");
+
+  bool load(pybind11::handle, bool) { return false; }
+
+  static pybind11::handle cast(const ArenaOwned<ProtoType>& src,
+                               pybind11::return_value_policy,
+                               pybind11::handle) {
+    if (src.get() == nullptr) return pybind11::none().release();
+    return PyFrozenProtoFromMessage(src.share()).release();
+  }
+
+  explicit operator ArenaOwned<ProtoType>&() { return value; }
+  explicit operator ArenaOwned<ProtoType>*() { return &value; }
+
+  template <typename T_>
+  using cast_op_type = pybind11::detail::cast_op_type<T_>;
+
+  ArenaOwned<ProtoType> value;
+};
+
+}  // namespace pybind11_protobuf
+
+namespace pybind11 {
+namespace detail {
+
+template <typename ProtoType>
+struct type_caster<pybind11_protobuf::ArenaOwned<ProtoType>>
+    : public pybind11_protobuf::arena_owned_caster<ProtoType> {};
+
+}  // namespace detail
+}  // namespace pybind11
+
+#endif  // PYBIND11_PROTOBUF_ARENA_OWNED_H_
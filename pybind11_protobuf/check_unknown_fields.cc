@@ -1,32 +1,162 @@
 #include "pybind11_protobuf/check_unknown_fields.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <climits>
 #include <cstdint>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/types/optional.h"
 #include "google/protobuf/descriptor.h"
+#include "google/protobuf/descriptor.pb.h"
+#include "google/protobuf/descriptor_database.h"
+#include "google/protobuf/io/coded_stream.h"
 #include "google/protobuf/message.h"
 #include "google/protobuf/unknown_field_set.h"
-#include "python/google/protobuf/proto_api.h"
 
 namespace pybind11_protobuf::check_unknown_fields {
 namespace {
 
-using AllowListSet = absl::flat_hash_set<std::string>;
-using MayContainExtensionsMap =
-    absl::flat_hash_map<const ::google::protobuf::Descriptor*, bool>;
+using FieldPath = std::vector<const ::google::protobuf::FieldDescriptor*>;
 
-AllowListSet* GetAllowList() {
-  static auto* allow_list = new AllowListSet();
-  return allow_list;
+/// A map from keys to immortal values, which each thread reads through its
+/// own cache: lookups are lock-free once a thread has seen a key, and take the
+/// lock only on that thread's first lookup of it. Nothing is copied on
+/// insertion, and a thread's cache is freed when the thread exits.
+///
+/// Each instance must have a distinct Tag, which selects its thread-local
+/// cache.
+template <typename Tag, typename Key, typename Value>
+class ThreadCachedMap {
+ public:
+  using Map = absl::flat_hash_map<Key, Value*>;
+
+  /// Returns the value for key, calling insert(Map*) with the lock held to
+  /// add it if it is missing. insert must add key.
+  template <typename Fn>
+  Value& FindOrInsert(const Key& key, Fn insert) {
+    thread_local Map cache;
+    auto it = cache.find(key);
+    if (it != cache.end()) return *it->second;
+    Value* value;
+    {
+      absl::MutexLock l(&lock_);
+      auto shared = map_.find(key);
+      if (shared == map_.end()) {
+        insert(&map_);
+        shared = map_.find(key);
+        assert(shared != map_.end());
+      }
+      value = shared->second;
+    }
+    cache.emplace(key, value);
+    return *value;
+  }
+
+ private:
+  absl::Mutex lock_;
+  Map map_;
+};
+
+/// What FindUnknownFieldsRecursive needs to visit in a message of a given
+/// type, precomputed once per Descriptor.
+struct ScanPlan {
+  /// Whether the message or any message reachable from it has extension
+  /// ranges. If not, unknown fields can only be in the message itself.
+  bool may_contain_extensions = false;
+
+  /// Whether the message itself has extension ranges. Present extensions are
+  /// only found by Reflection::ListFields.
+  bool has_extension_ranges = false;
+
+  /// The message-typed fields of the message with may_contain_extensions.
+  std::vector<const ::google::protobuf::FieldDescriptor*> fields;
+};
+
+struct ScanPlanTag;
+using ScanPlanMap =
+    ThreadCachedMap<ScanPlanTag, const ::google::protobuf::Descriptor*,
+                    const ScanPlan>;
+
+/// Adds plans for root and every message type reachable from it to plans.
+void BuildScanPlans(const ::google::protobuf::Descriptor* root,
+                    ScanPlanMap::Map* plans) {
+  // Collect the reachable types which do not have a plan yet.
+  std::vector<const ::google::protobuf::Descriptor*> pending;
+  absl::flat_hash_map<const ::google::protobuf::Descriptor*, bool> may_contain_extensions;
+  auto visit = [&](const ::google::protobuf::Descriptor* descriptor) {
+    if (plans->contains(descriptor)) return;
+    if (may_contain_extensions
+            .try_emplace(descriptor, descriptor->extension_range_count() > 0)
+            .second) {
+      pending.push_back(descriptor);
+    }
+  };
+  visit(root);
+  for (size_t i = 0; i < pending.size(); ++i) {
+    for (int j = 0; j < pending[i]->field_count(); ++j) {
+      auto* fd = pending[i]->field(j);
+      if (fd->cpp_type() == ::google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE) {
+        visit(fd->message_type());
+      }
+    }
+  }
+
+  auto child_may_contain_extensions =
+      [&](const ::google::protobuf::FieldDescriptor* fd) {
+        if (fd->cpp_type() != ::google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE) {
+          return false;
+        }
+        auto it = plans->find(fd->message_type());
+        if (it != plans->end()) return it->second->may_contain_extensions;
+        return may_contain_extensions[fd->message_type()];
+      };
+
+  // Propagate to a fixed point, so that recursive types are handled
+  // correctly regardless of the order in which they were reached.
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (const auto* descriptor : pending) {
+      bool& may = may_contain_extensions[descriptor];
+      if (may) continue;
+      for (int j = 0; j < descriptor->field_count(); ++j) {
+        if (child_may_contain_extensions(descriptor->field(j))) {
+          may = changed = true;
+          break;
+        }
+      }
+    }
+  }
+
+  for (const auto* descriptor : pending) {
+    auto* plan = new ScanPlan();
+    plan->may_contain_extensions = may_contain_extensions[descriptor];
+    plan->has_extension_ranges = descriptor->extension_range_count() > 0;
+    for (int j = 0; j < descriptor->field_count(); ++j) {
+      if (child_may_contain_extensions(descriptor->field(j))) {
+        plan->fields.push_back(descriptor->field(j));
+      }
+    }
+    plans->emplace(descriptor, plan);
+  }
+}
+
+const ScanPlan& GetScanPlan(const ::google::protobuf::Descriptor* descriptor) {
+  static auto* plans = new ScanPlanMap();
+  return plans->FindOrInsert(descriptor, [descriptor](ScanPlanMap::Map* map) {
+    BuildScanPlans(descriptor, map);
+  });
 }
 
 std::string MakeAllowListKey(
@@ -36,57 +166,358 @@ std::string MakeAllowListKey(
                       unknown_field_parent_message_fqn);
 }
 
-/// Recurses through the message Descriptor class looking for valid extensions.
-/// Stores the result to `memoized`.
-bool MessageMayContainExtensionsRecursive(const ::google::protobuf::Descriptor* descriptor,
-                                          MayContainExtensionsMap* memoized) {
-  if (descriptor->extension_range_count() > 0) return true;
+std::string FieldPathFQN(const FieldPath& path) {
+  return absl::StrJoin(path, ".",
+                       [](std::string* out,
+                          const ::google::protobuf::FieldDescriptor* field) {
+                         absl::StrAppend(out, field->name());
+                       });
+}
 
-  auto [it, inserted] = memoized->try_emplace(descriptor, false);
-  if (!inserted) {
-    return it->second;
+/// Returns the message-typed fields of descriptor, including the extensions
+/// which its pool knows.
+std::vector<const ::google::protobuf::FieldDescriptor*> MessageFields(
+    const ::google::protobuf::Descriptor* descriptor) {
+  std::vector<const ::google::protobuf::FieldDescriptor*> fields;
+  descriptor->file()->pool()->FindAllExtensions(descriptor, &fields);
+  for (int i = 0; i < descriptor->field_count(); ++i) {
+    fields.push_back(descriptor->field(i));
   }
+  fields.erase(
+      std::remove_if(fields.begin(), fields.end(),
+                     [](const ::google::protobuf::FieldDescriptor* field) {
+                       return field->cpp_type() !=
+                              ::google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE;
+                     }),
+      fields.end());
+  return fields;
+}
 
-  for (int i = 0; i < descriptor->field_count(); i++) {
-    auto* fd = descriptor->field(i);
-    if (fd->cpp_type() != ::google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE) continue;
-    if (MessageMayContainExtensionsRecursive(fd->message_type(), memoized)) {
-      (*memoized)[descriptor] = true;
-      return true;
+/// Returns a shortest field path from root to a message of type target, or
+/// nullopt if there is none. Used to report an unknown extension found by the
+/// parser, which does not know where in the message it was.
+absl::optional<FieldPath> FindFieldPath(
+    const ::google::protobuf::Descriptor* root,
+    const ::google::protobuf::Descriptor* target) {
+  absl::flat_hash_map<const ::google::protobuf::Descriptor*,
+                      const ::google::protobuf::FieldDescriptor*>
+      reached_by = {{root, nullptr}};
+  std::vector<const ::google::protobuf::Descriptor*> pending = {root};
+  for (size_t i = 0; i < pending.size(); ++i) {
+    if (pending[i] == target) {
+      FieldPath path;
+      for (const auto* field = reached_by[target]; field != nullptr;
+           field = reached_by[field->containing_type()]) {
+        path.push_back(field);
+      }
+      std::reverse(path.begin(), path.end());
+      return path;
+    }
+    for (const auto* field : MessageFields(pending[i])) {
+      if (reached_by.try_emplace(field->message_type(), field).second) {
+        pending.push_back(field->message_type());
+      }
     }
   }
+  return absl::nullopt;
+}
 
-  return false;
+/// Returns the type of the message at the field path fqn from root, as
+/// written by FieldPathFQN, or nullptr if fqn does not name one.
+const ::google::protobuf::Descriptor* ResolveFieldPathFQN(
+    const ::google::protobuf::Descriptor* root, absl::string_view fqn) {
+  const ::google::protobuf::Descriptor* descriptor = root;
+  if (fqn.empty()) return descriptor;
+  for (absl::string_view name : absl::StrSplit(fqn, '.')) {
+    const ::google::protobuf::FieldDescriptor* next = nullptr;
+    for (const auto* field : MessageFields(descriptor)) {
+      if (field->name() == name) {
+        next = field;
+        break;
+      }
+    }
+    if (next == nullptr) return nullptr;
+    descriptor = next->message_type();
+  }
+  return descriptor;
+}
+
+std::string BuildErrorMessage(
+    const ::google::protobuf::Descriptor* root_descriptor,
+    const ::google::protobuf::Descriptor* unknown_field_parent_descriptor,
+    const FieldPath& field_path, int unknown_field_number) {
+  assert(unknown_field_parent_descriptor != nullptr);
+  assert(root_descriptor != nullptr);
+
+  std::string field_fqn = FieldPathFQN(field_path);
+  std::string emsg = absl::StrCat(  //
+      "Proto Message of type ", root_descriptor->full_name(),
+      " has an Unknown Field");
+  if (root_descriptor != unknown_field_parent_descriptor) {
+    absl::StrAppend(&emsg, " with parent of type ",
+                    unknown_field_parent_descriptor->full_name());
+  }
+  absl::StrAppend(&emsg, ": ",
+                  field_path.empty()
+                      ? absl::StrCat(unknown_field_number)
+                      : absl::StrCat(field_fqn, ".", unknown_field_number),
+                  " (", root_descriptor->file()->name());
+  if (root_descriptor->file() != unknown_field_parent_descriptor->file()) {
+    absl::StrAppend(&emsg, ", ",
+                    unknown_field_parent_descriptor->file()->name());
+  }
+  absl::StrAppend(
+      &emsg,
+      "). Please add the required `cc_proto_library` `deps`. "
+      "Only if there is no alternative to suppressing this error, use "
+      "`pybind11_protobuf::AllowUnknownFieldsFor(\"",
+      root_descriptor->full_name(), "\", \"", field_fqn,
+      "\");` (Warning: suppressions may mask critical bugs.)");
+
+  return emsg;
 }
 
-bool MessageMayContainExtensionsMemoized(const ::google::protobuf::Descriptor* descriptor) {
-  static auto* memoized = new MayContainExtensionsMap();
-  static absl::Mutex lock;
-  absl::MutexLock l(&lock);
-  return MessageMayContainExtensionsRecursive(descriptor, memoized);
+/// The allow-list as added by AllowUnknownFieldsFor, and compiled to
+/// (root Descriptor, field path) lookups as they are checked. It is only
+/// consulted when an unknown field has been found, so a lock is cheap enough.
+class AllowList {
+ public:
+  static AllowList* Get() {
+    static auto* allow_list = new AllowList();
+    return allow_list;
+  }
+
+  void Add(std::string key) {
+    absl::MutexLock l(&lock_);
+    entries_.insert(std::move(key));
+    // Invalidate earlier lookups.
+    compiled_.clear();
+    compiled_parents_.clear();
+  }
+
+  bool Contains(const ::google::protobuf::Descriptor* root, FieldPath path) {
+    absl::MutexLock l(&lock_);
+    CompiledKey key{root, std::move(path)};
+    auto it = compiled_.find(key);
+    if (it != compiled_.end()) return it->second;
+    bool allowed = entries_.contains(
+        MakeAllowListKey(root->full_name(), FieldPathFQN(key.second)));
+    compiled_.emplace(std::move(key), allowed);
+    return allowed;
+  }
+
+  /// Whether an entry for root names a field path to a message of type
+  /// parent. Used when only the type holding the unknown field is known.
+  bool ContainsPathTo(const ::google::protobuf::Descriptor* root,
+                      const ::google::protobuf::Descriptor* parent) {
+    absl::MutexLock l(&lock_);
+    auto key = std::make_pair(root, parent);
+    auto it = compiled_parents_.find(key);
+    if (it != compiled_parents_.end()) return it->second;
+    std::string prefix = MakeAllowListKey(root->full_name(), "");
+    bool allowed = false;
+    for (absl::string_view entry : entries_) {
+      if (absl::ConsumePrefix(&entry, prefix) &&
+          ResolveFieldPathFQN(root, entry) == parent) {
+        allowed = true;
+        break;
+      }
+    }
+    compiled_parents_.emplace(key, allowed);
+    return allowed;
+  }
+
+ private:
+  using CompiledKey =
+      std::pair<const ::google::protobuf::Descriptor*, FieldPath>;
+  using CompiledParentKey = std::pair<const ::google::protobuf::Descriptor*,
+                                      const ::google::protobuf::Descriptor*>;
+
+  absl::Mutex lock_;
+  absl::flat_hash_set<std::string> entries_;
+  absl::flat_hash_map<CompiledKey, bool> compiled_;
+  absl::flat_hash_map<CompiledParentKey, bool> compiled_parents_;
+};
+
+/// The options set by SetSampled(), numbered so that samplers notice when
+/// they change.
+struct ActiveSamplingOptions : SamplingOptions {
+  uint64_t generation = 0;
+};
+
+/// Sampling state of one message type for CheckSampled().
+struct TypeSampler {
+  explicit TypeSampler(const ActiveSamplingOptions& options)
+      : period(options.sample_period), generation(options.generation) {}
+
+  std::atomic<uint64_t> conversions{0};
+  std::atomic<uint32_t> period;
+  std::atomic<uint32_t> clean_streak{0};
+  std::atomic<uint64_t> generation;
+};
+
+std::atomic<const ActiveSamplingOptions*>& SamplingOptionsSingleton() {
+  static auto* options = new std::atomic<const ActiveSamplingOptions*>(
+      new ActiveSamplingOptions());
+  return *options;
 }
 
-struct HasUnknownFields {
-  HasUnknownFields(const ::google::protobuf::python::PyProto_API* py_proto_api,
-                   const ::google::protobuf::Descriptor* root_descriptor)
-      : py_proto_api(py_proto_api), root_descriptor(root_descriptor) {}
+std::atomic<uint64_t> check_count{0};
+std::atomic<uint64_t> violation_count{0};
+
+struct TypeSamplerTag;
+
+/// Returns the sampler of a type, restarted from options if they changed
+/// since it last sampled.
+TypeSampler& GetTypeSampler(const ::google::protobuf::Descriptor* descriptor,
+                            const ActiveSamplingOptions& options) {
+  using SamplerMap =
+      ThreadCachedMap<TypeSamplerTag, const ::google::protobuf::Descriptor*,
+                      TypeSampler>;
+  static auto* samplers = new SamplerMap();
+  TypeSampler& sampler =
+      samplers->FindOrInsert(descriptor, [&](SamplerMap::Map* map) {
+        map->emplace(descriptor, new TypeSampler(options));
+      });
+  if (sampler.generation.load(std::memory_order_relaxed) !=
+      options.generation) {
+    sampler.conversions.store(0, std::memory_order_relaxed);
+    sampler.period.store(options.sample_period, std::memory_order_relaxed);
+    sampler.clean_streak.store(0, std::memory_order_relaxed);
+    sampler.generation.store(options.generation, std::memory_order_relaxed);
+  }
+  return sampler;
+}
+
+/// Returns whether this conversion of a type is to be checked.
+bool SampleConversion(TypeSampler& sampler) {
+  uint32_t period = sampler.period.load(std::memory_order_relaxed);
+  return period <= 1 ||
+         sampler.conversions.fetch_add(1, std::memory_order_relaxed) %
+                 period ==
+             0;
+}
+
+/// Counts a check with the given result, and adjusts the sampling period of
+/// the type. Returns the error to report.
+absl::optional<std::string> RecordCheck(const SamplingOptions& options,
+                                        TypeSampler& sampler,
+                                        absl::optional<std::string> error) {
+  check_count.fetch_add(1, std::memory_order_relaxed);
+  if (!error) {
+    if (options.backoff_after != 0 &&
+        sampler.clean_streak.fetch_add(1, std::memory_order_relaxed) + 1 >=
+            options.backoff_after) {
+      sampler.clean_streak.store(0, std::memory_order_relaxed);
+      // Doubling saturates rather than wrapping to a short period.
+      uint32_t period = sampler.period.load(std::memory_order_relaxed);
+      uint32_t doubled =
+          period > options.max_sample_period / 2 ? options.max_sample_period
+                                                 : period * 2;
+      sampler.period.store(doubled, std::memory_order_relaxed);
+    }
+    return absl::nullopt;
+  }
 
-  std::string FieldFQN() const { return absl::StrJoin(field_fqn_parts, "."); }
-  std::string FieldFQNWithFieldNumber() const {
-    return field_fqn_parts.empty()
-               ? absl::StrCat(unknown_field_number)
-               : absl::StrCat(FieldFQN(), ".", unknown_field_number);
+  violation_count.fetch_add(1, std::memory_order_relaxed);
+  sampler.clean_streak.store(0, std::memory_order_relaxed);
+  sampler.period.store(options.sample_period, std::memory_order_relaxed);
+  if (!options.raise_on_violation) {
+    return absl::nullopt;
+  }
+  return error;
+}
+
+/// Fallback database of the extension pool used by ParsePartialAndCheck. The
+/// parser asks it for every extension number which the generated pool does not
+/// know. It records the first one known to Python, and never returns a file,
+/// so that the extension is still kept as an unknown field.
+class UnknownExtensionRecorder : public ::google::protobuf::DescriptorDatabase {
+ public:
+  void Reset(const ::google::protobuf::DescriptorPool* python_pool) {
+    python_pool_ = python_pool;
+    containing_type_ = nullptr;
+    field_number_ = 0;
+  }
+
+  /// The generated type extended by the recorded extension, or nullptr if
+  /// there is none.
+  const ::google::protobuf::Descriptor* containing_type() const {
+    return containing_type_;
+  }
+  int field_number() const { return field_number_; }
+
+  bool FindFileByName(const std::string& filename,
+                      ::google::protobuf::FileDescriptorProto* output) override {
+    return false;
+  }
+
+  bool FindFileContainingSymbol(
+      const std::string& symbol_name,
+      ::google::protobuf::FileDescriptorProto* output) override {
+    return false;
   }
 
+  bool FindFileContainingExtension(
+      const std::string& containing_type, int field_number,
+      ::google::protobuf::FileDescriptorProto* output) override {
+    if (containing_type_ == nullptr && python_pool_ != nullptr) {
+      const auto* descriptor = python_pool_->FindMessageTypeByName(containing_type);
+      if (descriptor != nullptr &&
+          python_pool_->FindExtensionByNumber(descriptor, field_number) !=
+              nullptr) {
+        containing_type_ =
+            ::google::protobuf::DescriptorPool::generated_pool()->FindMessageTypeByName(
+                containing_type);
+        field_number_ = field_number;
+      }
+    }
+    return false;
+  }
+
+ private:
+  const ::google::protobuf::DescriptorPool* python_pool_ = nullptr;
+  const ::google::protobuf::Descriptor* containing_type_ = nullptr;
+  int field_number_ = 0;
+};
+
+/// Extension registry for parsing generated messages: the generated pool,
+/// with UnknownExtensionRecorder as the fallback for everything else.
+struct RecordingExtensionRegistry {
+  RecordingExtensionRegistry() {
+    pool.internal_set_underlay(::google::protobuf::DescriptorPool::generated_pool());
+  }
+
+  static RecordingExtensionRegistry& ForThisThread() {
+    thread_local RecordingExtensionRegistry registry;
+    return registry;
+  }
+
+  UnknownExtensionRecorder recorder;
+  ::google::protobuf::DescriptorPool pool{&recorder};
+};
+
+struct HasUnknownFields {
+  HasUnknownFields(const ::google::protobuf::DescriptorPool* python_pool,
+                   const ::google::protobuf::Descriptor* root_descriptor)
+      : python_pool(python_pool), root_descriptor(root_descriptor) {}
+
   bool FindUnknownFieldsRecursive(const ::google::protobuf::Message* sub_message,
                                   uint32_t depth);
+  bool FindUnknownFieldsInField(const ::google::protobuf::Message* sub_message,
+                                const ::google::protobuf::FieldDescriptor* field,
+                                uint32_t depth);
 
-  std::string BuildErrorMessage() const;
+  std::string BuildErrorMessage() const {
+    return check_unknown_fields::BuildErrorMessage(
+        root_descriptor, unknown_field_parent_descriptor, field_path,
+        unknown_field_number);
+  }
 
-  const ::google::protobuf::python::PyProto_API* py_proto_api;
+  const ::google::protobuf::DescriptorPool* python_pool;
   const ::google::protobuf::Descriptor* root_descriptor = nullptr;
   const ::google::protobuf::Descriptor* unknown_field_parent_descriptor = nullptr;
-  std::vector<std::string> field_fqn_parts;
+  FieldPath field_path;
   int unknown_field_number;
 };
 
@@ -103,16 +534,27 @@ bool HasUnknownFields::FindUnknownFieldsRecursive(
     unknown_field_number = unknown_field_set.field(0).number();
 
     // Stop only if the extension is known by Python.
-    if (py_proto_api->GetDefaultDescriptorPool()->FindExtensionByNumber(
-            unknown_field_parent_descriptor, unknown_field_number)) {
-      field_fqn_parts.resize(depth);
+    if (python_pool->FindExtensionByNumber(unknown_field_parent_descriptor,
+                                           unknown_field_number)) {
+      field_path.resize(depth);
       return true;
     }
   }
 
   // If this message does not include submessages which allow extensions,
   // then it cannot include unknown fields.
-  if (!MessageMayContainExtensionsMemoized(sub_message->GetDescriptor())) {
+  const ScanPlan& plan = GetScanPlan(sub_message->GetDescriptor());
+  if (!plan.may_contain_extensions) {
+    return false;
+  }
+
+  if (!plan.has_extension_ranges) {
+    // Only the fields in the plan can lead to unknown fields.
+    for (const auto* field : plan.fields) {
+      if (FindUnknownFieldsInField(sub_message, field, depth)) {
+        return true;
+      }
+    }
     return false;
   }
 
@@ -125,19 +567,7 @@ bool HasUnknownFields::FindUnknownFieldsRecursive(
     if (field->cpp_type() != ::google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE) {
       continue;
     }
-    if (field->is_repeated()) {
-      int field_size = reflection.FieldSize(*sub_message, field);
-      for (int i = 0; i != field_size; ++i) {
-        if (FindUnknownFieldsRecursive(
-                &reflection.GetRepeatedMessage(*sub_message, field, i),
-                depth + 1U)) {
-          field_fqn_parts[depth] = field->name();
-          return true;
-        }
-      }
-    } else if (FindUnknownFieldsRecursive(
-                   &reflection.GetMessage(*sub_message, field), depth + 1U)) {
-      field_fqn_parts[depth] = field->name();
+    if (FindUnknownFieldsInField(sub_message, field, depth)) {
       return true;
     }
   }
@@ -145,55 +575,164 @@ bool HasUnknownFields::FindUnknownFieldsRecursive(
   return false;
 }
 
-std::string HasUnknownFields::BuildErrorMessage() const {
-  assert(unknown_field_parent_descriptor != nullptr);
-  assert(root_descriptor != nullptr);
-
-  std::string emsg = absl::StrCat(  //
-      "Proto Message of type ", root_descriptor->full_name(),
-      " has an Unknown Field");
-  if (root_descriptor != unknown_field_parent_descriptor) {
-    absl::StrAppend(&emsg, " with parent of type ",
-                    unknown_field_parent_descriptor->full_name());
-  }
-  absl::StrAppend(&emsg, ": ", FieldFQNWithFieldNumber(), " (",
-                  root_descriptor->file()->name());
-  if (root_descriptor->file() != unknown_field_parent_descriptor->file()) {
-    absl::StrAppend(&emsg, ", ",
-                    unknown_field_parent_descriptor->file()->name());
+bool HasUnknownFields::FindUnknownFieldsInField(
+    const ::google::protobuf::Message* sub_message,
+    const ::google::protobuf::FieldDescriptor* field, uint32_t depth) {
+  const ::google::protobuf::Reflection& reflection = *sub_message->GetReflection();
+  if (field->is_repeated()) {
+    int field_size = reflection.FieldSize(*sub_message, field);
+    for (int i = 0; i != field_size; ++i) {
+      if (FindUnknownFieldsRecursive(
+              &reflection.GetRepeatedMessage(*sub_message, field, i),
+              depth + 1U)) {
+        field_path[depth] = field;
+        return true;
+      }
+    }
+  } else if (reflection.HasField(*sub_message, field) &&
+             FindUnknownFieldsRecursive(
+                 &reflection.GetMessage(*sub_message, field), depth + 1U)) {
+    field_path[depth] = field;
+    return true;
   }
-  absl::StrAppend(
-      &emsg,
-      "). Please add the required `cc_proto_library` `deps`. "
-      "Only if there is no alternative to suppressing this error, use "
-      "`pybind11_protobuf::AllowUnknownFieldsFor(\"",
-      root_descriptor->full_name(), "\", \"", FieldFQN(),
-      "\");` (Warning: suppressions may mask critical bugs.)");
+  return false;
+}
 
-  return emsg;
+/// Returns the error for an unknown extension numbered unknown_field_number
+/// of a message of type parent, found by the parser somewhere in a message of
+/// type root.
+absl::optional<std::string> UnknownExtensionError(
+    const ::google::protobuf::Descriptor* root,
+    const ::google::protobuf::Descriptor* parent, int unknown_field_number) {
+  if (AllowList::Get()->ContainsPathTo(root, parent)) {
+    return absl::nullopt;
+  }
+  return BuildErrorMessage(root, parent,
+                           FindFieldPath(root, parent).value_or(FieldPath()),
+                           unknown_field_number);
 }
 
 }  // namespace
 
 void AllowUnknownFieldsFor(absl::string_view top_message_descriptor_full_name,
                            absl::string_view unknown_field_parent_message_fqn) {
-  GetAllowList()->insert(MakeAllowListKey(top_message_descriptor_full_name,
-                                          unknown_field_parent_message_fqn));
+  AllowList::Get()->Add(MakeAllowListKey(top_message_descriptor_full_name,
+                                         unknown_field_parent_message_fqn));
 }
 
 absl::optional<std::string> CheckRecursively(
-    const ::google::protobuf::python::PyProto_API* py_proto_api,
+    const ::google::protobuf::DescriptorPool* python_pool,
     const ::google::protobuf::Message* message) {
   const auto* root_descriptor = message->GetDescriptor();
-  HasUnknownFields search{py_proto_api, root_descriptor};
+  HasUnknownFields search{python_pool, root_descriptor};
   if (!search.FindUnknownFieldsRecursive(message, 0u)) {
     return absl::nullopt;
   }
-  if (GetAllowList()->count(MakeAllowListKey(root_descriptor->full_name(),
-                                             search.FieldFQN())) != 0) {
+  if (AllowList::Get()->Contains(root_descriptor, search.field_path)) {
     return absl::nullopt;
   }
   return search.BuildErrorMessage();
 }
 
+#if defined(PYBIND11_PROTOBUF_HAS_PROTO_API)
+absl::optional<std::string> CheckRecursively(
+    const ::google::protobuf::python::PyProto_API* py_proto_api,
+    const ::google::protobuf::Message* message) {
+  return CheckRecursively(py_proto_api->GetDefaultDescriptorPool(), message);
+}
+#endif
+
+void ExtensionsWithUnknownFieldsPolicy::SetSampled(
+    const SamplingOptions& options) {
+  auto* copy = new ActiveSamplingOptions();
+  static_cast<SamplingOptions&>(*copy) = options;
+  if (copy->sample_period == 0) copy->sample_period = 1;
+  if (copy->max_sample_period < copy->sample_period) {
+    copy->max_sample_period = copy->sample_period;
+  }
+  // The previous options are leaked, since they may still be in use.
+  static std::atomic<uint64_t> generations{0};
+  copy->generation = generations.fetch_add(1, std::memory_order_relaxed) + 1;
+  SamplingOptionsSingleton().store(copy, std::memory_order_release);
+  StrongSetDisallow();
+}
+
+absl::optional<std::string> CheckSampled(
+    const ::google::protobuf::DescriptorPool* python_pool,
+    const ::google::protobuf::Message* message) {
+  const ActiveSamplingOptions& options =
+      *SamplingOptionsSingleton().load(std::memory_order_acquire);
+  TypeSampler& sampler = GetTypeSampler(message->GetDescriptor(), options);
+  if (!SampleConversion(sampler)) {
+    return absl::nullopt;
+  }
+  return RecordCheck(options, sampler, CheckRecursively(python_pool, message));
+}
+
+CheckCounters GetCheckCounters() {
+  CheckCounters counters;
+  counters.checks = check_count.load(std::memory_order_relaxed);
+  counters.violations = violation_count.load(std::memory_order_relaxed);
+  return counters;
+}
+
+bool ParsePartialAndCheck(
+    const ::google::protobuf::DescriptorPool* python_pool,
+    absl::string_view serialized, ::google::protobuf::Message* message,
+    absl::optional<std::string>* error) {
+  *error = absl::nullopt;
+
+  // The extension registry replaces the pool used for extensions, so it is
+  // only suitable for generated messages.
+  if (message->GetDescriptor()->file()->pool() !=
+          ::google::protobuf::DescriptorPool::generated_pool() ||
+      serialized.size() > static_cast<size_t>(INT_MAX)) {
+    if (!message->ParsePartialFromString(serialized)) {
+      return false;
+    }
+    *error = CheckRecursively(python_pool, message);
+    return true;
+  }
+
+  auto& registry = RecordingExtensionRegistry::ForThisThread();
+  registry.recorder.Reset(python_pool);
+  message->Clear();
+  ::google::protobuf::io::CodedInputStream input(
+      reinterpret_cast<const uint8_t*>(serialized.data()),
+      static_cast<int>(serialized.size()));
+  input.SetExtensionRegistry(&registry.pool,
+                             ::google::protobuf::MessageFactory::generated_factory());
+  if (!message->MergePartialFromCodedStream(&input) ||
+      !input.ConsumedEntireMessage()) {
+    return false;
+  }
+
+  // The recorder saw every unknown extension, so the message need not be
+  // walked.
+  if (registry.recorder.containing_type() != nullptr) {
+    *error = UnknownExtensionError(message->GetDescriptor(),
+                                   registry.recorder.containing_type(),
+                                   registry.recorder.field_number());
+  }
+  return true;
+}
+
+bool ParsePartialAndCheckSampled(
+    const ::google::protobuf::DescriptorPool* python_pool,
+    absl::string_view serialized, ::google::protobuf::Message* message,
+    absl::optional<std::string>* error) {
+  *error = absl::nullopt;
+  const ActiveSamplingOptions& options =
+      *SamplingOptionsSingleton().load(std::memory_order_acquire);
+  TypeSampler& sampler = GetTypeSampler(message->GetDescriptor(), options);
+  if (!SampleConversion(sampler)) {
+    return message->ParsePartialFromString(serialized);
+  }
+  if (!ParsePartialAndCheck(python_pool, serialized, message, error)) {
+    return false;
+  }
+  *error = RecordCheck(options, sampler, std::move(*error));
+  return true;
+}
+
 }  // namespace pybind11_protobuf::check_unknown_fields
@@ -1,15 +1,46 @@
 #ifndef PYBIND11_PROTOBUF_CHECK_UNKNOWN_FIELDS_H_
 #define PYBIND11_PROTOBUF_CHECK_UNKNOWN_FIELDS_H_
 
+#include <cstdint>
 #include <string>
 
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
+#include "google/protobuf/descriptor.h"
 #include "google/protobuf/message.h"
+
+// The PyProto_API overload of CheckRecursively is only declared where the
+// protobuf Python headers are available.
+#if defined(__has_include)
+#if __has_include("python/google/protobuf/proto_api.h")
 #include "python/google/protobuf/proto_api.h"
+#define PYBIND11_PROTOBUF_HAS_PROTO_API 1
+#endif
+#endif
 
 namespace pybind11_protobuf::check_unknown_fields {
 
+// Configuration for ExtensionsWithUnknownFieldsPolicy::SetSampled().
+struct SamplingOptions {
+  // Fully check 1 in sample_period conversions of each message type.
+  uint32_t sample_period = 1;
+
+  // After backoff_after clean checks in a row for a message type, its period
+  // doubles, up to max_sample_period. A violation resets the period to
+  // sample_period. 0 disables the backoff.
+  uint32_t backoff_after = 0;
+  uint32_t max_sample_period = 1;
+
+  // Whether a violation is reported as an error, or only counted.
+  bool raise_on_violation = true;
+};
+
+// Totals since startup, across all message types.
+struct CheckCounters {
+  uint64_t checks = 0;
+  uint64_t violations = 0;
+};
+
 class ExtensionsWithUnknownFieldsPolicy {
   enum State {
     // Initial state.
@@ -38,17 +69,71 @@ class ExtensionsWithUnknownFieldsPolicy {
 
   static void StrongSetDisallow() { GetStateSingleton() = kStrongDisallow; }
 
+  // Primary use case: production binaries which want the safety net without
+  // checking every conversion. Enables the check like StrongSetDisallow(),
+  // for the conversions sampled as configured by options. Each message type
+  // restarts sampling from the new options at its next conversion.
+  static void SetSampled(const SamplingOptions& options);
+
   static bool UnknownFieldsAreDisallowed() {
     return GetStateSingleton() != kWeakEnableFallbackToSerializeParse;
   }
+
+  // Whether the casters check messages parsed into generated C++ types. Only
+  // binaries which opted in with StrongSetDisallow() or SetSampled() pay for
+  // the check.
+  static bool UnknownFieldsAreChecked() {
+    return GetStateSingleton() == kStrongDisallow;
+  }
 };
 
 void AllowUnknownFieldsFor(absl::string_view top_message_descriptor_full_name,
                            absl::string_view unknown_field_parent_message_fqn);
 
+// Returns an error if top_message has an unknown field which python_pool, the
+// pool of the types known to Python, knows as an extension; unless the field
+// is allowed by AllowUnknownFieldsFor().
+absl::optional<std::string> CheckRecursively(
+    const ::google::protobuf::DescriptorPool* python_pool,
+    const ::google::protobuf::Message* top_message);
+
+#if defined(PYBIND11_PROTOBUF_HAS_PROTO_API)
+// Deprecated: checks against py_proto_api->GetDefaultDescriptorPool(). Use the
+// DescriptorPool overload.
 absl::optional<std::string> CheckRecursively(
     const ::google::protobuf::python::PyProto_API* py_proto_api,
     const ::google::protobuf::Message* top_message);
+#endif
+
+// Like CheckRecursively, but only checks the conversions sampled as configured
+// by ExtensionsWithUnknownFieldsPolicy::SetSampled() (by default, all of
+// them). Violations are counted, and only returned if raise_on_violation.
+absl::optional<std::string> CheckSampled(
+    const ::google::protobuf::DescriptorPool* python_pool,
+    const ::google::protobuf::Message* top_message);
+
+// Returns the counters of CheckSampled() and ParsePartialAndCheckSampled().
+// pybind11_protobuf::DefineUnknownFieldCheckCounters() exposes them to Python.
+CheckCounters GetCheckCounters();
+
+// Parses serialized into message, like ParsePartialFromString, and sets
+// *error to the result of CheckRecursively on the parsed message. For messages
+// from the generated pool the parser records unknown extensions as it goes,
+// and the message is not walked: the error names a shortest field path to the
+// type holding the extension, and AllowUnknownFieldsFor() entries match any
+// field path to that type. Returns false if parsing failed.
+bool ParsePartialAndCheck(
+    const ::google::protobuf::DescriptorPool* python_pool,
+    absl::string_view serialized, ::google::protobuf::Message* message,
+    absl::optional<std::string>* error);
+
+// Like ParsePartialAndCheck, but only checks the conversions sampled as
+// configured by ExtensionsWithUnknownFieldsPolicy::SetSampled(), like
+// CheckSampled. Other conversions are parsed with ParsePartialFromString.
+bool ParsePartialAndCheckSampled(
+    const ::google::protobuf::DescriptorPool* python_pool,
+    absl::string_view serialized, ::google::protobuf::Message* message,
+    absl::optional<std::string>* error);
 
 }  // namespace pybind11_protobuf::check_unknown_fields
 
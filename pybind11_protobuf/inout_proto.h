@@ -0,0 +1,137 @@
+// IWYU pragma: always_keep // See pybind11/docs/type_caster_iwyu.rst
+
+#ifndef PYBIND11_PROTOBUF_INOUT_PROTO_H_
+#define PYBIND11_PROTOBUF_INOUT_PROTO_H_
+
+#include <pybind11/cast.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/pytypes.h>
+
+#include <Python.h>
+
+#include <exception>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "google/protobuf/message.h"
+#include "pybind11_protobuf/proto_cast_util.h"
+#include "pybind11_protobuf/proto_caster_impl.h"
+
+// InOut<T> is a proto parameter type for C++ functions which modify a message
+// in place. The function receives a mutable copy of the Python message; when
+// the call returns, only the fields it changed are written back into the
+// caller's Python message. This avoids both the unsafe mutable casts and
+// returning a whole new message for Python to copy back.
+//
+// Changes are written back even when the function throws, as they would be
+// for a Python function modifying its argument.
+//
+// Example:
+//
+// #include "pybind11_protobuf/inout_proto.h"
+//
+// void MutateMessage(MyMessage* in_out) { ... }
+//
+// PYBIND11_MODULE(my_module, m) {
+//   pybind11_protobuf::ImportNativeProtoCasters();
+//
+//   m.def("mutate_message",
+//         [](pybind11_protobuf::InOut<MyMessage> in_out) {
+//           MutateMessage(in_out.get());
+//         });
+// }
+
+namespace pybind11_protobuf {
+
+/// A mutable copy of a Python message, whose changes are written back into
+/// the Python message when the call returns. Valid only during the call.
+template <typename ProtoType>
+class InOut {
+  static_assert(std::is_base_of<::google::protobuf::Message, ProtoType>::value,
+                "InOut requires a ::google::protobuf::Message type");
+
+ public:
+  InOut() = default;
+  explicit InOut(ProtoType* value) : value_(value) {}
+
+  ProtoType* get() const { return value_; }
+  ProtoType& operator*() const { return *value_; }
+  ProtoType* operator->() const { return value_; }
+
+ private:
+  ProtoType* value_ = nullptr;
+};
+
+// type_caster<> implementation for InOut<T>.
+template <typename ProtoType>
+struct inout_proto_caster {
+  static constexpr auto name = pybind11::detail::const_name<ProtoType>();
+
+  inout_proto_caster() = default;
+  inout_proto_caster(const inout_proto_caster&) = delete;
+  inout_proto_caster& operator=(const inout_proto_caster&) = delete;
+
+  // Writes the changes back, if the value was passed to the function.
+  ~inout_proto_caster() {
+    if (!passed_ || !src_) return;
+    try {
+      PyProtoUpdateFromDiff(src_, *loader_.value, *copy_);
+    } catch (pybind11::error_already_set& e) {
+      e.discard_as_unraisable(__func__);
+    } catch (const std::exception& e) {
+      PyErr_SetString(PyExc_TypeError, e.what());
+      PyErr_WriteUnraisable(nullptr);
+    }
+  }
+
+  // load converts from Python -> C++. None is rejected, since there is no
+  // message to write back to.
+  bool load(pybind11::handle src, bool convert) {
+    if (!src || src.is_none() || !loader_.load(src, convert)) return false;
+    // loader_ keeps the message as it was, to diff against.
+    copy_.reset(static_cast<ProtoType*>(loader_.value->New()));
+    copy_->CopyFrom(*loader_.value);
+    value_ = InOut<ProtoType>(copy_.get());
+    src_ = src;
+    return true;
+  }
+
+  explicit operator InOut<ProtoType>&() {
+    passed_ = true;
+    return value_;
+  }
+  explicit operator InOut<ProtoType>*() {
+    passed_ = true;
+    return &value_;
+  }
+  explicit operator InOut<ProtoType>&&() && {
+    passed_ = true;
+    return std::move(value_);
+  }
+
+  template <typename T_>
+  using cast_op_type = pybind11::detail::movable_cast_op_type<T_>;
+
+ private:
+  proto_caster_load_impl<ProtoType> loader_;
+  std::unique_ptr<ProtoType> copy_;
+  InOut<ProtoType> value_;
+  // The Python message; alive for the duration of the call.
+  pybind11::handle src_;
+  bool passed_ = false;
+};
+
+}  // namespace pybind11_protobuf
+
+namespace pybind11 {
+namespace detail {
+
+template <typename ProtoType>
+struct type_caster<pybind11_protobuf::InOut<ProtoType>>
+    : public pybind11_protobuf::inout_proto_caster<ProtoType> {};
+
+}  // namespace detail
+}  // namespace pybind11
+
+#endif  // PYBIND11_PROTOBUF_INOUT_PROTO_H_
@@ -0,0 +1,199 @@
+// IWYU pragma: always_keep // See pybind11/docs/type_caster_iwyu.rst
+
+#ifndef PYBIND11_PROTOBUF_LAZY_PROTO_H_
+#define PYBIND11_PROTOBUF_LAZY_PROTO_H_
+
+#include <pybind11/cast.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/pytypes.h>
+
+#include <Python.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "google/protobuf/message.h"
+#include "pybind11_protobuf/proto_cast_util.h"
+#include "pybind11_protobuf/proto_caster_impl.h"
+
+// Lazy<T> is a proto argument type which defers the Python -> C++ conversion
+// until the argument is used. Binding a function with a Lazy<T> parameter
+// only checks the type of the Python object; it is serialized and parsed on
+// the first call to get(), if any. This suits arguments which are read only
+// on rare paths, such as error reporting.
+//
+// Example:
+//
+// #include "pybind11_protobuf/lazy_proto.h"
+//
+// PYBIND11_MODULE(my_module, m) {
+//   pybind11_protobuf::ImportNativeProtoCasters();
+//
+//   m.def("run", [](const Request& request,
+//                   const pybind11_protobuf::Lazy<Overrides>& overrides) {
+//     if (NeedsOverrides(request)) Apply(*overrides);
+//     ...
+//   });
+// }
+
+namespace pybind11_protobuf {
+
+/// A Python message converted to a ProtoType on first use. get() may be called
+/// from any thread, with or without the GIL, until the Lazy is destroyed.
+template <typename ProtoType>
+class Lazy {
+  static_assert(std::is_base_of<::google::protobuf::Message, ProtoType>::value,
+                "Lazy requires a ::google::protobuf::Message type");
+
+ public:
+  Lazy() = default;
+
+  // Requires the GIL. convert is as for the proto type_caster<>.
+  Lazy(pybind11::object src, bool convert)
+      : src_(std::move(src)), convert_(convert), is_none_(src_.is_none()) {}
+
+  Lazy(Lazy&& other) noexcept
+      : src_(std::move(other.src_)),
+        convert_(other.convert_),
+        is_none_(other.is_none_),
+        value_(other.value_.load(std::memory_order_acquire)),
+        owned_(std::move(other.owned_)) {
+    other.value_.store(nullptr, std::memory_order_relaxed);
+  }
+
+  Lazy& operator=(Lazy&& other) noexcept {
+    if (this != &other) {
+      // Releases the current object, with the GIL if necessary.
+      Lazy old(std::move(*this));
+      src_ = std::move(other.src_);
+      convert_ = other.convert_;
+      is_none_ = other.is_none_;
+      value_.store(other.value_.load(std::memory_order_acquire),
+                   std::memory_order_release);
+      owned_ = std::move(other.owned_);
+      other.value_.store(nullptr, std::memory_order_relaxed);
+    }
+    return *this;
+  }
+
+  ~Lazy() {
+    if (!src_ || PyGILState_Check()) return;
+    if (!Py_IsInitialized()) {
+      // The object cannot be released during finalization; leak it.
+      src_.release();
+      return;
+    }
+    pybind11::gil_scoped_acquire gil;
+    src_ = pybind11::object();
+  }
+
+  /// True when the argument was None.
+  bool is_none() const { return is_none_; }
+
+  /// Returns the converted message, or nullptr if the argument was None.
+  /// Raises TypeError if the message cannot be converted.
+  const ProtoType* get() const {
+    const ProtoType* value = value_.load(std::memory_order_acquire);
+    if (value != nullptr || is_none_ || !src_) return value;
+    return Load();
+  }
+
+  const ProtoType& operator*() const { return *get(); }
+  const ProtoType* operator->() const { return get(); }
+
+  /// Returns the Python message.
+  const pybind11::object& object() const { return src_; }
+
+ private:
+  const ProtoType* Load() const {
+    pybind11::gil_scoped_acquire gil;
+    proto_caster_load_impl<ProtoType> loader;
+    if (!loader.load(src_, convert_)) {
+      throw pybind11::type_error(
+          absl::StrCat("Failed to convert ",
+                       pybind11::repr(src_).template cast<std::string>(),
+                       " to a C++ message"));
+    }
+    // Converting runs Python code, which may let another thread convert
+    // concurrently; the first result wins.
+    const ProtoType* expected = nullptr;
+    if (value_.compare_exchange_strong(expected, loader.value,
+                                       std::memory_order_acq_rel)) {
+      // Only the winner writes owned_, and only the destructor reads it.
+      owned_ = std::move(loader.owned);
+      return loader.value;
+    }
+    return expected;
+  }
+
+  pybind11::object src_;
+  bool convert_ = false;
+  bool is_none_ = false;
+
+  // Either points into the C++ message backing src_, or equals owned_.
+  mutable std::atomic<const ProtoType*> value_{nullptr};
+  mutable std::unique_ptr<ProtoType> owned_;
+};
+
+// type_caster<> implementation for Lazy<T>.
+template <typename ProtoType>
+struct lazy_proto_caster {
+  static constexpr auto name = pybind11::detail::const_name<ProtoType>();
+
+  // load only checks that src is a ProtoType message, or None, so that
+  // overload resolution behaves as for the proto type_caster<>.
+  bool load(pybind11::handle src, bool convert) {
+    if (!src) return false;
+    if (!src.is_none() && !IsProto(src)) return false;
+    value = Lazy<ProtoType>(pybind11::reinterpret_borrow<pybind11::object>(src),
+                            convert);
+    return true;
+  }
+
+  explicit operator Lazy<ProtoType>*() { return &value; }
+  explicit operator Lazy<ProtoType>&() { return value; }
+  explicit operator Lazy<ProtoType>&&() && { return std::move(value); }
+
+  template <typename T_>
+  using cast_op_type = pybind11::detail::movable_cast_op_type<T_>;
+
+  static bool IsProto(pybind11::handle src) {
+    const ::google::protobuf::Message* frozen = PyFrozenProtoGetMessage(src);
+    if constexpr (std::is_same<ProtoType, ::google::protobuf::Message>::value) {
+      return frozen != nullptr || PyProtoGetCppMessagePointer(src) != nullptr ||
+             PyProtoDescriptorFullName(src).has_value();
+    } else {
+      if (frozen) {
+        return frozen->GetDescriptor()->full_name() ==
+               ProtoType::GetDescriptor()->full_name();
+      }
+      const ::google::protobuf::Message* message =
+          PyProtoGetCppMessagePointer(src);
+      if (message &&
+          ::google::protobuf::DynamicCastToGenerated<ProtoType>(message)) {
+        return true;
+      }
+      return PyProtoHasMatchingFullName(src, ProtoType::GetDescriptor());
+    }
+  }
+
+  Lazy<ProtoType> value;
+};
+
+}  // namespace pybind11_protobuf
+
+namespace pybind11 {
+namespace detail {
+
+template <typename ProtoType>
+struct type_caster<pybind11_protobuf::Lazy<ProtoType>>
+    : public pybind11_protobuf::lazy_proto_caster<ProtoType> {};
+
+}  // namespace detail
+}  // namespace pybind11
+
+#endif  // PYBIND11_PROTOBUF_LAZY_PROTO_H_
@@ -15,6 +15,7 @@
 
 #include "absl/strings/string_view.h"
 #include "google/protobuf/message.h"
+#include "pybind11_protobuf/check_unknown_fields.h"
 #include "pybind11_protobuf/enum_type_caster.h"
 #include "pybind11_protobuf/proto_caster_impl.h"
 
@@ -58,6 +59,21 @@ inline void ImportNativeProtoCasters() { InitializePybindProtoCastUtil(); }
 inline void AllowUnknownFieldsFor(
     absl::string_view top_message_descriptor_full_name,
     absl::string_view unknown_field_parent_message_fqn) {
+  check_unknown_fields::AllowUnknownFieldsFor(top_message_descriptor_full_name,
+                                              unknown_field_parent_message_fqn);
+}
+
+// Defines unknown_field_check_counters() in module m, returning a dict with the
+// check_unknown_fields::GetCheckCounters() totals, 'checks' and 'violations'.
+inline void DefineUnknownFieldCheckCounters(pybind11::module_& m) {
+  m.def("unknown_field_check_counters", []() {
+    check_unknown_fields::CheckCounters counters =
+        check_unknown_fields::GetCheckCounters();
+    pybind11::dict result;
+    result["checks"] = counters.checks;
+    result["violations"] = counters.violations;
+    return result;
+  });
 }
 
 }  // namespace pybind11_protobuf
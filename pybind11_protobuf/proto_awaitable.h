@@ -0,0 +1,332 @@
+#ifndef PYBIND11_PROTOBUF_PROTO_AWAITABLE_H_
+#define PYBIND11_PROTOBUF_PROTO_AWAITABLE_H_
+
+#include <pybind11/pybind11.h>
+#include <pybind11/pytypes.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "google/protobuf/message.h"
+#include "pybind11_protobuf/proto_cast_util.h"
+#include "pybind11_protobuf/wrapped_proto_caster.h"
+
+// Adapters which expose asynchronous C++ APIs returning protos as Python
+// asyncio awaitables.
+//
+// The message is serialized on the C++ thread which completes the operation;
+// the event loop thread only constructs the Python message from the bytes.
+// The awaitable must be created while an asyncio event loop is running.
+//
+// Example:
+//
+// #include "pybind11_protobuf/proto_awaitable.h"
+//
+// std::future<absl::StatusOr<MyMessage>> Lookup(const MyRequest& request);
+// void LookupAsync(MyRequest request,
+//                  std::function<void(absl::StatusOr<MyMessage>)> done);
+//
+// PYBIND11_MODULE(my_module, m) {
+//   pybind11_protobuf::ImportWrappedProtoCasters();
+//
+//   using pybind11_protobuf::WithAwaitableProtos;
+//   m.def("lookup", WithAwaitableProtos(&Lookup));
+//
+//   m.def("lookup_async",
+//         pybind11_protobuf::WithWrappedProtos([](MyRequest request) {
+//           return pybind11_protobuf::MakeProtoAwaitable<MyMessage>(
+//               [&](pybind11_protobuf::ProtoCompletion<MyMessage> done) {
+//                 LookupAsync(std::move(request), std::move(done));
+//               });
+//         }));
+// }
+//
+// async def main():
+//   response = await my_module.lookup(request)
+
+namespace pybind11_protobuf {
+namespace impl {
+
+// The asyncio future of a pending awaitable, and the loop which owns it.
+class AwaitableState {
+ public:
+  // Requires the GIL.
+  AwaitableState() {
+    loop_ = pybind11::module_::import("asyncio").attr("get_running_loop")();
+    future_ = loop_.attr("create_future")();
+  }
+
+  AwaitableState(const AwaitableState&) = delete;
+  AwaitableState& operator=(const AwaitableState&) = delete;
+
+  // May be destroyed on any thread.
+  ~AwaitableState() {
+    if (!Py_IsInitialized()) {
+      // The objects cannot be released during finalization; leak them.
+      loop_.release();
+      future_.release();
+      return;
+    }
+    pybind11::gil_scoped_acquire gil;
+    loop_ = pybind11::object();
+    future_ = pybind11::object();
+  }
+
+  const pybind11::object& future() const { return future_; }
+
+  // Resolves the future with the result of make_result(), which is called on
+  // the event loop thread. May be called from any thread without the GIL.
+  void Resolve(std::function<pybind11::object()> make_result) {
+    // Nobody is waiting for the result during finalization.
+    if (!Py_IsInitialized()) return;
+    pybind11::gil_scoped_acquire gil;
+    pybind11::object future = future_;
+    CallSoonThreadsafe(pybind11::cpp_function([future, make_result]() {
+      // The future may have been cancelled in the meantime.
+      if (future.attr("done")().cast<bool>()) return;
+      // An exception escaping the callback would only be logged by the loop,
+      // and leave the future pending forever.
+      try {
+        future.attr("set_result")(make_result());
+      } catch (pybind11::error_already_set& e) {
+        future.attr("set_exception")(e.value());
+      } catch (pybind11::builtin_exception& e) {
+        e.set_error();
+        future.attr("set_exception")(pybind11::error_already_set().value());
+      } catch (const std::exception& e) {
+        future.attr("set_exception")(
+            pybind11::reinterpret_borrow<pybind11::object>(PyExc_RuntimeError)(
+                e.what()));
+      }
+    }));
+  }
+
+  // Fails the future with a RuntimeError whose code attribute is the integer
+  // value of the status code. May be called from any thread without the GIL.
+  void Reject(absl::Status status) {
+    if (!Py_IsInitialized()) return;
+    pybind11::gil_scoped_acquire gil;
+    pybind11::object future = future_;
+    CallSoonThreadsafe(pybind11::cpp_function([future, status]() {
+      if (future.attr("done")().cast<bool>()) return;
+      pybind11::object error =
+          pybind11::reinterpret_borrow<pybind11::object>(PyExc_RuntimeError)(
+              status.ToString());
+      error.attr("code") = static_cast<int>(status.code());
+      future.attr("set_exception")(error);
+    }));
+  }
+
+ private:
+  void CallSoonThreadsafe(pybind11::cpp_function callback) {
+    try {
+      loop_.attr("call_soon_threadsafe")(std::move(callback));
+    } catch (pybind11::error_already_set&) {
+      // The loop has been closed, so nobody is waiting for the result.
+    }
+  }
+
+  pybind11::object loop_;
+  pybind11::object future_;
+};
+
+// Waits for the std::futures of all pending awaitables on one shared thread.
+// std::future cannot notify when it becomes ready, so the thread polls the
+// pending futures, backing off while none of them completes.
+class FutureWaiter {
+ public:
+  // Calls poll on the waiter thread until it returns true. poll must not
+  // block until the future is ready.
+  static void Add(std::function<bool()> poll) {
+    // Never destroyed, since the thread is never joined.
+    static FutureWaiter* waiter = new FutureWaiter();
+    {
+      std::lock_guard<std::mutex> lock(waiter->mutex_);
+      waiter->added_.push_back(std::move(poll));
+    }
+    waiter->cv_.notify_one();
+  }
+
+ private:
+  static constexpr std::chrono::microseconds kMinInterval{100};
+  static constexpr std::chrono::microseconds kMaxInterval{10000};
+
+  FutureWaiter() { std::thread([this] { Run(); }).detach(); }
+
+  void Run() {
+    std::vector<std::function<bool()>> pending;
+    std::chrono::microseconds interval = kMinInterval;
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (pending.empty()) {
+          cv_.wait(lock, [this] { return !added_.empty(); });
+        } else if (added_.empty()) {
+          cv_.wait_for(lock, interval);
+        }
+        if (!added_.empty()) interval = kMinInterval;
+        for (auto& poll : added_) pending.push_back(std::move(poll));
+        added_.clear();
+      }
+      // Completions run without the lock, since they acquire the GIL.
+      size_t waiting = pending.size();
+      pending.erase(std::remove_if(pending.begin(), pending.end(),
+                                   [](std::function<bool()>& poll) {
+                                     return poll();
+                                   }),
+                    pending.end());
+      interval = pending.size() < waiting
+                     ? kMinInterval
+                     : std::min(interval * 2, kMaxInterval);
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<std::function<bool()>> added_;
+};
+
+// Maps the result type of a std::future to its proto type.
+template <typename T>
+struct AwaitableResult {
+  using proto_type = T;
+};
+
+template <typename T>
+struct AwaitableResult<absl::StatusOr<T>> {
+  using proto_type = T;
+};
+
+}  // namespace impl
+
+/// Completes an awaitable created by MakeProtoAwaitable. It may be copied, and
+/// called once from any thread, without the GIL.
+template <typename ProtoType>
+class ProtoCompletion {
+  static_assert(std::is_base_of<::google::protobuf::Message, ProtoType>::value,
+                "ProtoCompletion requires a ::google::protobuf::Message type");
+
+ public:
+  explicit ProtoCompletion(std::shared_ptr<impl::AwaitableState> state)
+      : state_(std::move(state)) {}
+
+  void operator()(absl::StatusOr<ProtoType> result) const {
+    if (!result.ok()) {
+      state_->Reject(result.status());
+      return;
+    }
+    // Serialize here, so that the event loop only has to parse.
+    const ::google::protobuf::Descriptor* descriptor = result->GetDescriptor();
+    std::string serialized = result->SerializePartialAsString();
+    state_->Resolve([descriptor, serialized = std::move(serialized)]() {
+      return PyProtoFromSerializedString(descriptor, serialized);
+    });
+  }
+
+ private:
+  std::shared_ptr<impl::AwaitableState> state_;
+};
+
+/// Returns an awaitable for a callback-completion API. start is called with
+/// the GIL released, and must arrange for the completion to be called once.
+template <typename ProtoType>
+pybind11::object MakeProtoAwaitable(
+    std::function<void(ProtoCompletion<ProtoType>)> start) {
+  auto state = std::make_shared<impl::AwaitableState>();
+  pybind11::object future = state->future();
+  {
+    pybind11::gil_scoped_release release;
+    start(ProtoCompletion<ProtoType>(std::move(state)));
+  }
+  return future;
+}
+
+/// Returns an awaitable for a std::future of a proto or of an
+/// absl::StatusOr<proto>. std::future has no continuations, so one thread
+/// shared by all such awaitables waits for the results. A deferred future is
+/// evaluated here, with the GIL released, rather than on that thread, where it
+/// would hold up the other awaitables.
+template <typename T>
+pybind11::object MakeProtoAwaitable(std::future<T> result) {
+  using ProtoType = typename impl::AwaitableResult<T>::proto_type;
+  auto shared_result = std::make_shared<std::future<T>>(std::move(result));
+  return MakeProtoAwaitable<ProtoType>(
+      [shared_result](ProtoCompletion<ProtoType> done) {
+        auto complete = [shared_result, done]() {
+          try {
+            done(shared_result->get());
+          } catch (const std::exception& e) {
+            done(absl::UnknownError(e.what()));
+          }
+        };
+        if (shared_result->wait_for(std::chrono::seconds(0)) ==
+            std::future_status::deferred) {
+          complete();
+          return;
+        }
+        impl::FutureWaiter::Add([shared_result, complete]() {
+          if (shared_result->wait_for(std::chrono::seconds(0)) ==
+              std::future_status::timeout) {
+            return false;
+          }
+          complete();
+          return true;
+        });
+      });
+}
+
+namespace impl {
+
+template <typename F, typename>
+struct AwaitableInvoker;
+
+template <typename F, typename R, typename... Args>
+struct AwaitableInvoker<F, R(Args...)> {
+  F f;
+  pybind11::object operator()(typename WrapHelper<Args>::type... args) const {
+    return MakeProtoAwaitable(f(std::forward<decltype(args)>(args)...));
+  }
+};
+
+template <typename F, typename R, typename... Args>
+struct AwaitableInvoker<F, R(Args...) const> {
+  F f;
+  pybind11::object operator()(typename WrapHelper<Args>::type... args) const {
+    return MakeProtoAwaitable(f(std::forward<decltype(args)>(args)...));
+  }
+};
+
+}  // namespace impl
+
+/// WithAwaitableProtos(...) wraps a function returning a std::future of a proto
+/// (or of an absl::StatusOr<proto>) as a function returning an awaitable. Proto
+/// arguments are converted as by WithWrappedProtos.
+template <typename F, int&... ExplicitArgumentBarrier,
+          typename S = impl::LambdaSignature<decltype(&F::operator())>>
+auto WithAwaitableProtos(F f) ->
+    typename impl::AwaitableInvoker<F, typename S::type> {
+  return {std::move(f)};
+}
+
+template <typename R, typename... Args>
+impl::AwaitableInvoker<R (*)(Args...), R(Args...)>  //
+WithAwaitableProtos(R (*f)(Args...)) {
+  return {f};
+}
+
+}  // namespace pybind11_protobuf
+
+#endif  // PYBIND11_PROTOBUF_PROTO_AWAITABLE_H_
@@ -0,0 +1,262 @@
+// IWYU pragma: always_keep // See pybind11/docs/type_caster_iwyu.rst
+
+#ifndef PYBIND11_PROTOBUF_PROTO_CALLBACK_H_
+#define PYBIND11_PROTOBUF_PROTO_CALLBACK_H_
+
+#include <pybind11/cast.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/pytypes.h>
+
+#include <Python.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "google/protobuf/message.h"
+#include "pybind11_protobuf/proto_cast_util.h"
+
+// ProtoCallback<T> wraps a Python callable for C++ code which calls it with
+// messages at a high rate, as a replacement for std::function<void(const T&)>.
+//
+// Compared to the pybind11/functional.h conversion, the Python message class
+// is looked up once rather than per call, and messages are serialized before
+// the GIL is taken. CallEach invokes the handler for many messages under a
+// single GIL hold.
+//
+// A handler which does not keep its argument, or anything obtained from it,
+// beyond the call may declare so:
+//
+//   def on_event(event):
+//     counts[event.kind] += 1
+//   on_event.pybind11_protobuf_reuse_message = True
+//
+// The callback then passes the same Python message to every call, resetting
+// it with Clear() and MergeFromString(), instead of allocating a new one.
+//
+// Example:
+//
+// #include "pybind11_protobuf/proto_callback.h"
+//
+// PYBIND11_MODULE(my_module, m) {
+//   pybind11_protobuf::ImportNativeProtoCasters();
+//
+//   m.def("register_handler",
+//         [](pybind11_protobuf::ProtoCallback<MyEvent> handler) {
+//           GetPluginRegistry().Register(std::move(handler));
+//         });
+// }
+
+namespace pybind11_protobuf {
+
+// Attribute by which a Python handler declares that its argument may be
+// reused after the call returns.
+constexpr char kProtoCallbackReuseMessageAttribute[] =
+    "pybind11_protobuf_reuse_message";
+
+namespace impl {
+
+// The Python handler of a ProtoCallback, and its cached message class.
+class ProtoCallbackState {
+ public:
+  struct Serialized {
+    const ::google::protobuf::Descriptor* descriptor;
+    std::string bytes;
+  };
+
+  // Requires the GIL.
+  explicit ProtoCallbackState(pybind11::function handler)
+      : handler_(std::move(handler)),
+        reuse_message_(pybind11::getattr(handler_,
+                                         kProtoCallbackReuseMessageAttribute,
+                                         pybind11::bool_(false))
+                           .cast<bool>()) {}
+
+  ProtoCallbackState(const ProtoCallbackState&) = delete;
+  ProtoCallbackState& operator=(const ProtoCallbackState&) = delete;
+
+  // May be destroyed on any thread.
+  ~ProtoCallbackState() {
+    if (!Py_IsInitialized()) {
+      // The objects cannot be released during finalization; leak them.
+      handler_.release();
+      message_class_.release();
+      reusable_.release();
+      return;
+    }
+    pybind11::gil_scoped_acquire gil;
+    handler_ = pybind11::function();
+    message_class_ = pybind11::object();
+    reusable_ = pybind11::object();
+  }
+
+  const pybind11::function& handler() const { return handler_; }
+
+  // Calls the handler once per message, in order, under a single GIL hold.
+  // May be called from any thread, with or without the GIL.
+  void Call(absl::Span<const Serialized> messages) {
+    pybind11::gil_scoped_acquire gil;
+    for (const Serialized& message : messages) {
+      CallOne(message);
+    }
+  }
+
+ private:
+  void CallOne(const Serialized& message) {
+    if (message.descriptor != descriptor_) {
+      message_class_ = PyProtoMessageClass(message.descriptor);
+      descriptor_ = message.descriptor;
+      reusable_ = pybind11::object();
+    }
+    // The handler may release the GIL, letting another thread call in while
+    // the reusable message is still in use.
+    if (!reuse_message_ || in_use_) {
+      handler_(PyProtoFromSerializedString(message_class_, message.descriptor,
+                                           message.bytes));
+      return;
+    }
+
+    if (reusable_) {
+      reusable_.attr("Clear")();
+    } else {
+      reusable_ = message_class_();
+    }
+    PyProtoMergeFromSerializedString(reusable_, message.descriptor,
+                                     message.bytes);
+    pybind11::object argument = reusable_;
+    in_use_ = true;
+    try {
+      handler_(argument);
+    } catch (...) {
+      in_use_ = false;
+      reusable_ = pybind11::object();
+      throw;
+    }
+    in_use_ = false;
+    // Stop reusing a message which the handler kept despite declaring
+    // otherwise; references held here are argument and reusable_.
+    if (argument.ref_count() > 2) {
+      reuse_message_ = false;
+      reusable_ = pybind11::object();
+    }
+  }
+
+  pybind11::function handler_;
+  bool reuse_message_;
+
+  // Guarded by the GIL.
+  const ::google::protobuf::Descriptor* descriptor_ = nullptr;
+  pybind11::object message_class_;
+  pybind11::object reusable_;
+  bool in_use_ = false;
+};
+
+}  // namespace impl
+
+/// A Python callable taking a ProtoType. It may be copied, and called from
+/// any thread, with or without the GIL. Exceptions raised by the handler
+/// propagate as pybind11::error_already_set. Like std::function, calling an
+/// empty callback, e.g. one converted from None, throws
+/// std::bad_function_call.
+template <typename ProtoType>
+class ProtoCallback {
+  static_assert(std::is_base_of<::google::protobuf::Message, ProtoType>::value,
+                "ProtoCallback requires a ::google::protobuf::Message type");
+
+ public:
+  ProtoCallback() = default;
+
+  // Requires the GIL.
+  explicit ProtoCallback(pybind11::function handler)
+      : state_(std::make_shared<impl::ProtoCallbackState>(std::move(handler))) {
+  }
+
+  explicit operator bool() const { return state_ != nullptr; }
+
+  /// Returns the Python handler. Requires the GIL.
+  const pybind11::function& handler() const { return state().handler(); }
+
+  void operator()(const ProtoType& message) const {
+    impl::ProtoCallbackState& callback_state = state();
+    impl::ProtoCallbackState::Serialized serialized{
+        message.GetDescriptor(), message.SerializePartialAsString()};
+    callback_state.Call(absl::MakeConstSpan(&serialized, 1));
+  }
+
+  /// Calls the handler for each message of a range, taking the GIL once.
+  template <typename Range>
+  void CallEach(const Range& messages) const {
+    impl::ProtoCallbackState& callback_state = state();
+    std::vector<impl::ProtoCallbackState::Serialized> serialized;
+    for (const ProtoType& message : messages) {
+      serialized.push_back(
+          {message.GetDescriptor(), message.SerializePartialAsString()});
+    }
+    if (!serialized.empty()) callback_state.Call(serialized);
+  }
+
+ private:
+  impl::ProtoCallbackState& state() const {
+    if (!state_) throw std::bad_function_call();
+    return *state_;
+  }
+
+  std::shared_ptr<impl::ProtoCallbackState> state_;
+};
+
+// type_caster<> implementation for ProtoCallback<T>.
+template <typename ProtoType>
+struct proto_callback_caster {
+  static constexpr auto name =
+      (pybind11::detail::const_name("Callable[[") +
+       pybind11::detail::const_name<ProtoType>() +
+       pybind11::detail::const_name("], None]"));
+
+  // load converts from Python -> C++. None converts to an empty callback,
+  // only when converting, as for std::function.
+  bool load(pybind11::handle src, bool convert) {
+    if (src && src.is_none()) {
+      if (!convert) return false;
+      value = ProtoCallback<ProtoType>();
+      return true;
+    }
+    if (!src || !PyCallable_Check(src.ptr())) return false;
+    value = ProtoCallback<ProtoType>(
+        pybind11::reinterpret_borrow<pybind11::function>(src));
+    return true;
+  }
+
+  // cast converts from C++ -> Python, returning the original handler.
+  static pybind11::handle cast(const ProtoCallback<ProtoType>& src,
+                               pybind11::return_value_policy policy,
+                               pybind11::handle parent) {
+    if (!src) return pybind11::none().release();
+    return pybind11::object(src.handler()).release();
+  }
+
+  explicit operator ProtoCallback<ProtoType>&() { return value; }
+  explicit operator ProtoCallback<ProtoType>*() { return &value; }
+
+  template <typename T_>
+  using cast_op_type = pybind11::detail::cast_op_type<T_>;
+
+  ProtoCallback<ProtoType> value;
+};
+
+}  // namespace pybind11_protobuf
+
+namespace pybind11 {
+namespace detail {
+
+template <typename ProtoType>
+struct type_caster<pybind11_protobuf::ProtoCallback<ProtoType>>
+    : public pybind11_protobuf::proto_callback_caster<ProtoType> {};
+
+}  // namespace detail
+}  // namespace pybind11
+
+#endif  // PYBIND11_PROTOBUF_PROTO_CALLBACK_H_
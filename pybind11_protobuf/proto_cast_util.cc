@@ -6,17 +6,29 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/pytypes.h>
 
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
 #include <initializer_list>
 #include <iostream>
+#include <iterator>
+#include <list>
 #include <memory>
 #include <string>
 #include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
 #include "absl/memory/memory.h"
+#include "absl/strings/cord.h"
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_replace.h"
@@ -27,6 +39,19 @@
 #include "google/protobuf/descriptor.pb.h"
 #include "google/protobuf/descriptor_database.h"
 #include "google/protobuf/dynamic_message.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/wire_format.h"
+#include "google/protobuf/wire_format_lite.h"
+#include "pybind11_protobuf/check_unknown_fields.h"
+#include "pybind11_protobuf/proto_cast_util_testing.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace py = pybind11;
 
@@ -34,9 +59,12 @@ using ::google::protobuf::Descriptor;
 using ::google::protobuf::DescriptorDatabase;
 using ::google::protobuf::DescriptorPool;
 using ::google::protobuf::DynamicMessageFactory;
+using ::google::protobuf::FieldDescriptor;
+using ::google::protobuf::FileDescriptor;
 using ::google::protobuf::FileDescriptorProto;
 using ::google::protobuf::Message;
 using ::google::protobuf::MessageFactory;
+using ::google::protobuf::Reflection;
 
 namespace pybind11_protobuf {
 
@@ -57,6 +85,11 @@ std::string InferPythonModuleNameFromDescriptorFileName(
 
 namespace {
 
+// Serialized messages at least this large are parsed from a Cord sharing the
+// Python buffer. For smaller ones, building the Cord costs more than copying
+// any Cord fields.
+constexpr size_t kCordParseThreshold = 64 * 1024;
+
 // Resolves the class name of a descriptor via d->containing_type()
 py::object ResolveDescriptor(py::object p, const Descriptor* d) {
   return d->containing_type() ? ResolveDescriptor(p, d->containing_type())
@@ -163,7 +196,12 @@ class GlobalState {
 
   // Allocate a python proto message instance using the native python
   // allocations.
-  py::object PyMessageInstance(const Descriptor* descriptor);
+  py::object PyMessageInstance(const Descriptor* descriptor) {
+    return PyMessageClass(descriptor)();
+  }
+
+  // Returns the python message class for descriptor.
+  py::object PyMessageClass(const Descriptor* descriptor);
 
   // Allocates a fast cpp proto python object, also returning
   // the embedded c++ proto2 message type. The returned message
@@ -232,13 +270,13 @@ py::module_ GlobalState::ImportCached(const std::string& module_name) {
   return module;
 }
 
-py::object GlobalState::PyMessageInstance(const Descriptor* descriptor) {
+py::object GlobalState::PyMessageClass(const Descriptor* descriptor) {
   auto module_name =
       InferPythonModuleNameFromDescriptorFileName(descriptor->file()->name());
   if (!module_name.empty()) {
     auto cached = import_cache_.find(module_name);
     if (cached != import_cache_.end()) {
-      return ResolveDescriptor(cached->second, descriptor)();
+      return ResolveDescriptor(cached->second, descriptor);
     }
   }
 
@@ -254,7 +292,7 @@ py::object GlobalState::PyMessageInstance(const Descriptor* descriptor) {
         // is deprecated. See b/258832141.
         p = get_prototype_(d);
       }
-      return p();
+      return p;
     } catch (...) {
       // TODO(pybind11-infra): narrow down to expected exception(s).
       PyErr_Clear();
@@ -264,7 +302,7 @@ py::object GlobalState::PyMessageInstance(const Descriptor* descriptor) {
   // If that fails, attempt to import the module.
   if (!module_name.empty()) {
     try {
-      return ResolveDescriptor(ImportCached(module_name), descriptor)();
+      return ResolveDescriptor(ImportCached(module_name), descriptor);
     } catch (py::error_already_set& e) {
       // TODO(pybind11-infra): narrow down to expected exception(s).
       e.restore();
@@ -279,6 +317,148 @@ py::object GlobalState::PyMessageInstance(const Descriptor* descriptor) {
                    module_name, "?"));
 }
 
+// Read-only view of a file's contents: a memory mapping where mmap is
+// available, otherwise a heap copy.
+class MappedFile {
+ public:
+  // Returns nullptr if path cannot be read.
+  static std::unique_ptr<MappedFile> Open(const std::string& path) {
+#if defined(_WIN32)
+    std::ifstream input(path, std::ios::binary);
+    if (!input) return nullptr;
+    auto file = absl::WrapUnique(new MappedFile());
+    file->copy_.assign(std::istreambuf_iterator<char>(input),
+                       std::istreambuf_iterator<char>());
+    file->contents_ = file->copy_;
+    return file;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      close(fd);
+      return nullptr;
+    }
+    auto file = absl::WrapUnique(new MappedFile());
+    if (st.st_size > 0) {
+      void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED) {
+        close(fd);
+        return nullptr;
+      }
+      file->contents_ =
+          absl::string_view(static_cast<const char*>(data), st.st_size);
+    }
+    close(fd);
+    return file;
+#endif
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile() {
+#if !defined(_WIN32)
+    if (!contents_.empty()) {
+      munmap(const_cast<char*>(contents_.data()), contents_.size());
+    }
+#endif
+  }
+
+  absl::string_view contents() const { return contents_; }
+
+ private:
+  MappedFile() = default;
+
+  absl::string_view contents_;
+#if defined(_WIN32)
+  std::string copy_;
+#endif
+};
+
+// Splits a serialized FileDescriptorSet into its encoded FileDescriptorProtos
+// without parsing them. Returns false if data is not a FileDescriptorSet.
+bool SplitEncodedFileDescriptorSet(absl::string_view data,
+                                   std::vector<absl::string_view>* files) {
+  // FileDescriptorSet.file is field 1, and length-delimited.
+  constexpr uint32_t kFileTag = (1 << 3) | 2;
+  ::google::protobuf::io::CodedInputStream input(
+      reinterpret_cast<const uint8_t*>(data.data()),
+      static_cast<int>(data.size()));
+  while (uint32_t tag = input.ReadTag()) {
+    uint32_t length;
+    if (tag != kFileTag || !input.ReadVarint32(&length)) {
+      return false;
+    }
+    int offset = input.CurrentPosition();
+    if (!input.Skip(static_cast<int>(length))) {
+      return false;
+    }
+    files->push_back(data.substr(offset, length));
+  }
+  return input.ConsumedEntireMessage();
+}
+
+// Returns FileDescriptorProto.name from an encoded FileDescriptorProto,
+// without parsing the rest of it.
+absl::optional<std::string> EncodedFileDescriptorName(
+    absl::string_view encoded) {
+  // FileDescriptorProto.name is field 1, and length-delimited.
+  constexpr uint32_t kNameTag = (1 << 3) | 2;
+  ::google::protobuf::io::CodedInputStream input(
+      reinterpret_cast<const uint8_t*>(encoded.data()),
+      static_cast<int>(encoded.size()));
+  while (uint32_t tag = input.ReadTag()) {
+    if (tag == kNameTag) {
+      std::string name;
+      if (!input.ReadString(&name)) break;
+      return name;
+    }
+    if (!::google::protobuf::internal::WireFormatLite::SkipField(&input, tag)) {
+      break;
+    }
+  }
+  return absl::nullopt;
+}
+
+// Snapshots start with this magic, followed by the length-prefixed fingerprint
+// they were written with, followed by a serialized FileDescriptorSet.
+constexpr absl::string_view kSnapshotMagic = "PB11SNP1";
+
+std::string EncodeSnapshotHeader(absl::string_view fingerprint) {
+  std::string header(kSnapshotMagic);
+  {
+    ::google::protobuf::io::StringOutputStream stream(&header);
+    ::google::protobuf::io::CodedOutputStream output(&stream);
+    output.WriteVarint32(static_cast<uint32_t>(fingerprint.size()));
+    output.WriteRaw(fingerprint.data(), static_cast<int>(fingerprint.size()));
+  }
+  return header;
+}
+
+// Returns the FileDescriptorSet of a snapshot, or nullopt if contents is not
+// a snapshot written with fingerprint.
+absl::optional<absl::string_view> DecodeSnapshot(absl::string_view contents,
+                                                 absl::string_view fingerprint) {
+  if (!absl::StartsWith(contents, kSnapshotMagic)) {
+    return absl::nullopt;
+  }
+  contents.remove_prefix(kSnapshotMagic.size());
+  ::google::protobuf::io::CodedInputStream input(
+      reinterpret_cast<const uint8_t*>(contents.data()),
+      static_cast<int>(contents.size()));
+  uint32_t length;
+  if (!input.ReadVarint32(&length) || length != fingerprint.size()) {
+    return absl::nullopt;
+  }
+  contents.remove_prefix(input.CurrentPosition());
+  if (!absl::StartsWith(contents, fingerprint)) {
+    return absl::nullopt;
+  }
+  contents.remove_prefix(fingerprint.size());
+  return contents;
+}
+
 // Create C++ DescriptorPools based on Python DescriptorPools.
 // The Python pool will provide message definitions when they are needed.
 // This gives an efficient way to create C++ Messages from Python definitions.
@@ -300,6 +480,8 @@ class PythonDescriptorPoolWrapper {
     std::unique_ptr<DescriptorDatabase> database;
     std::unique_ptr<const DescriptorPool> pool;
     std::unique_ptr<MessageFactory> factory;
+    // True when pool is backed by the C++ generated_pool().
+    bool is_default_pool = false;
   };
 
   // Return (and maybe create) a C++ DescriptorPool that corresponds to the
@@ -336,21 +518,140 @@ class PythonDescriptorPoolWrapper {
     //   the proto_caster class.
     // This is done only for the Default pool, because generated C++ modules
     // and generated Python modules are built from the same .proto sources.
-    if (python_pool.is(GlobalState::instance()->global_pool())) {
+    // Other pools get a narrower version of this optimization in
+    // GetPrototype().
+    bool is_default_pool =
+        python_pool.is(GlobalState::instance()->global_pool());
+    if (is_default_pool) {
       pool->internal_set_underlay(DescriptorPool::generated_pool());
       factory->SetDelegateToGeneratedFactory(true);
     }
 
     // Cache the created objects.
-    pool_entry = Data{std::move(database), std::move(pool), std::move(factory)};
+    pool_entry = Data{std::move(database), std::move(pool), std::move(factory),
+                      is_default_pool};
     return &pool_entry;
   }
 
+  // See testing::GetPythonDescriptorPoolStats().
+  testing::PythonDescriptorPoolStats GetStats(py::handle python_pool) {
+    const Data* data = GetPoolFromPythonPool(python_pool);
+    auto* database = static_cast<DescriptorPoolDatabase*>(data->database.get());
+    testing::PythonDescriptorPoolStats stats;
+    database->FindAllFileNames(&stats.file_names);
+    std::sort(stats.file_names.begin(), stats.file_names.end());
+    stats.file_names.erase(
+        std::unique(stats.file_names.begin(), stats.file_names.end()),
+        stats.file_names.end());
+    stats.python_lookups = database->python_lookups();
+    return stats;
+  }
+
+  // See WritePythonDescriptorPoolSnapshot().
+  bool WriteSnapshot(py::handle python_pool, const std::string& path,
+                     absl::string_view fingerprint) {
+    const Data* data = GetPoolFromPythonPool(python_pool);
+    ::google::protobuf::FileDescriptorSet snapshot;
+    static_cast<DescriptorPoolDatabase*>(data->database.get())
+        ->CopyLoadedFilesTo(&snapshot);
+
+    // Write to a temporary file first, so that concurrent readers never
+    // observe a partially written snapshot.
+    std::string temporary_path = absl::StrCat(path, ".tmp");
+    {
+      std::ofstream output(temporary_path,
+                           std::ios::binary | std::ios::trunc);
+      std::string header = EncodeSnapshotHeader(fingerprint);
+      if (!output ||
+          !output.write(header.data(),
+                        static_cast<std::streamsize>(header.size())) ||
+          !snapshot.SerializeToOstream(&output)) {
+        std::remove(temporary_path.c_str());
+        return false;
+      }
+    }
+    if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+      std::remove(temporary_path.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  // See LoadPythonDescriptorPoolSnapshot().
+  bool LoadSnapshot(py::handle python_pool, const std::string& path,
+                    absl::string_view fingerprint) {
+    auto snapshot = MappedFile::Open(path);
+    if (!snapshot) {
+      return false;
+    }
+    const Data* data = GetPoolFromPythonPool(python_pool);
+    return static_cast<DescriptorPoolDatabase*>(data->database.get())
+        ->AddSnapshot(std::move(snapshot), fingerprint);
+  }
+
+  // Returns the prototype to use for a descriptor of the given pool.
+  //
+  // Messages from pools other than the Default pool are DynamicMessages.
+  // When prefer_generated is true and the message type is identical to a C++
+  // generated type, i.e. the fingerprints of their files match, the
+  // generated prototype is returned instead, which has much faster
+  // reflection. Its descriptor belongs to the generated pool, so this is only
+  // for callers that want the generated type: code reflecting on the message
+  // with FieldDescriptors of the Python pool's types needs the
+  // DynamicMessage. Types which may contain extensions are excluded, since a
+  // DynamicMessage resolves extensions from its own pool whereas the
+  // generated type would leave them as unknown fields.
+  const Message* GetPrototype(const Data& data, const Descriptor* descriptor,
+                              bool prefer_generated) {
+    if (prefer_generated && !data.is_default_pool) {
+      const Descriptor* generated =
+          DescriptorPool::generated_pool()->FindMessageTypeByName(
+              descriptor->full_name());
+      if (generated != nullptr && generated != descriptor &&
+          FileFingerprint(generated->file()) ==
+              FileFingerprint(descriptor->file())) {
+        absl::flat_hash_set<const Descriptor*> visited;
+        if (!MayContainExtensions(descriptor, &visited)) {
+          const Message* prototype =
+              MessageFactory::generated_factory()->GetPrototype(generated);
+          if (prototype) {
+            return prototype;
+          }
+        }
+      }
+    }
+    return data.factory->GetPrototype(descriptor);
+  }
+
+  // Returns the prototype cached for the Python message class of src, or
+  // nullptr if no instance of that class has been converted yet.
+  const Message* FindCachedPrototype(py::handle src) const {
+    auto it = prototypes_by_class_.find(Py_TYPE(src.ptr()));
+    if (it == prototypes_by_class_.end()) {
+      return nullptr;
+    }
+    return it->second.prototype;
+  }
+
+  // Caches prototype for the Python message class of src.
+  void CachePrototype(py::handle src, const Message* prototype) {
+    PyTypeObject* message_class = Py_TYPE(src.ptr());
+    prototypes_by_class_.try_emplace(
+        message_class,
+        CachedPrototype{py::reinterpret_borrow<py::object>(
+                            reinterpret_cast<PyObject*>(message_class)),
+                        prototype});
+  }
+
  private:
   PythonDescriptorPoolWrapper() = default;
 
   // Similar to DescriptorPoolDatabase: wraps a Python DescriptorPool
   // as a DescriptorDatabase.
+  //
+  // Whenever a file is fetched from Python, its whole dependency closure is
+  // parsed in the same pass and cached by name, so that the C++ pool resolves
+  // imports from the cache instead of calling back into Python once per file.
   class DescriptorPoolDatabase : public DescriptorDatabase {
    public:
     DescriptorPoolDatabase(py::object python_pool)
@@ -364,9 +665,16 @@ class PythonDescriptorPoolWrapper {
         const std::string& filename
         ,
         FileDescriptorProto* output) override {
+      if (CopyCachedFile(filename, output) ||
+          FindInSnapshots([&](Snapshot& snapshot) {
+            return snapshot.files.FindFileByName(filename, output);
+          })) {
+        return true;
+      }
       try {
+        ++python_lookups_;
         auto file = pool_.attr("FindFileByName")(filename);
-        return CopyToFileDescriptorProto(file, output);
+        return LoadFileClosure(file, output);
       } catch (py::error_already_set& e) {
         std::cerr << "FindFileByName " << filename << " raised an error";
 
@@ -382,9 +690,16 @@ class PythonDescriptorPoolWrapper {
         const std::string& symbol_name
         ,
         FileDescriptorProto* output) override {
+      if (FindInSnapshots([&](Snapshot& snapshot) {
+            return snapshot.files.FindFileContainingSymbol(symbol_name,
+                                                           output);
+          })) {
+        return true;
+      }
       try {
+        ++python_lookups_;
         auto file = pool_.attr("FindFileContainingSymbol")(symbol_name);
-        return CopyToFileDescriptorProto(file, output);
+        return LoadFileClosure(file, output);
       } catch (py::error_already_set& e) {
         std::cerr << "FindFileContainingSymbol " << symbol_name
                    << " raised an error";
@@ -402,19 +717,31 @@ class PythonDescriptorPoolWrapper {
         const std::string& containing_type
         ,
         int field_number, FileDescriptorProto* output) override {
+      if (FindInSnapshots([&](Snapshot& snapshot) {
+            return snapshot.files.FindFileContainingExtension(
+                containing_type, field_number, output);
+          })) {
+        return true;
+      }
       try {
+        ++python_lookups_;
         auto descriptor = pool_.attr("FindMessageTypeByName")(containing_type);
         // Keep the intermediate FieldDescriptor in a named variable so that it
         // stays alive while we access its `.file` attribute and subsequently
         // serialize the FileDescriptorProto.  Without this, the UPB Python
         // runtime may free the FieldDescriptor wrapper (and its backing def
-        // pointers) before CopyToFileDescriptorProto finishes, leading to a
+        // pointers) before LoadFileClosure finishes, leading to a
         // heap-use-after-free.
         auto extension =
             pool_.attr("FindExtensionByNumber")(descriptor, field_number);
         auto file = extension.attr("file");
-        return CopyToFileDescriptorProto(file, output);
+        return LoadFileClosure(file, output);
       } catch (py::error_already_set& e) {
+        // Checking unknown fields looks up extension numbers which Python
+        // may not know either.
+        if (e.matches(PyExc_KeyError)) {
+          return false;
+        }
         std::cerr << "FindFileContainingExtension " << containing_type << " "
                    << field_number << " raised an error";
 
@@ -425,19 +752,226 @@ class PythonDescriptorPoolWrapper {
       return false;
     }
 
+    // Lists the files loaded from the Python pool or from snapshots so far.
+    // The Python DescriptorPool API has no way to enumerate its files, so
+    // this is the closure of every file requested through the methods above.
+    bool FindAllFileNames(std::vector<std::string>* output) override {
+      output->reserve(output->size() + files_.size());
+      for (const auto& entry : files_) {
+        output->push_back(entry.first);
+      }
+      for (const auto& snapshot : snapshots_) {
+        snapshot->files.FindAllFileNames(output);
+      }
+      return true;
+    }
+
+    // Adds the files of a snapshot written by CopyLoadedFilesTo(). They are
+    // indexed in place, and served ahead of the Python pool. Files which the
+    // Python pool does not define identically are skipped, and left to the
+    // Python pool. Returns false, leaving the database unchanged, if the
+    // snapshot was written with a different fingerprint, is malformed, or
+    // defines a file or symbol twice.
+    bool AddSnapshot(std::unique_ptr<MappedFile> file,
+                     absl::string_view fingerprint) {
+      auto contents = DecodeSnapshot(file->contents(), fingerprint);
+      std::vector<absl::string_view> encoded_files;
+      if (!contents ||
+          !SplitEncodedFileDescriptorSet(*contents, &encoded_files)) {
+        return false;
+      }
+      auto snapshot = absl::make_unique<Snapshot>();
+      for (absl::string_view encoded : encoded_files) {
+        if (!MatchesPythonPool(encoded)) {
+          continue;
+        }
+        if (!snapshot->files.Add(encoded.data(),
+                                 static_cast<int>(encoded.size()))) {
+          return false;
+        }
+      }
+      snapshot->file = std::move(file);
+      snapshots_.push_back(std::move(snapshot));
+      return true;
+    }
+
+    // Number of files looked up in the Python pool.
+    uint64_t python_lookups() const { return python_lookups_; }
+
+    // Copies every file known to this database into output, sorted by name.
+    void CopyLoadedFilesTo(::google::protobuf::FileDescriptorSet* output) {
+      std::vector<std::string> names;
+      FindAllFileNames(&names);
+      std::sort(names.begin(), names.end());
+      names.erase(std::unique(names.begin(), names.end()), names.end());
+      for (const std::string& name : names) {
+        FileDescriptorProto* file = output->add_file();
+        if (!CopyCachedFile(name, file)) {
+          FindInSnapshots([&](Snapshot& snapshot) {
+            return snapshot.files.FindFileByName(name, file);
+          });
+        }
+      }
+    }
+
    private:
-    bool CopyToFileDescriptorProto(py::handle py_file_descriptor,
-                                   FileDescriptorProto* output) {
+    // Returns true if the Python pool has a file of the same name as the
+    // encoded FileDescriptorProto, with identical contents. This compares
+    // serialized_pb without parsing it, and does not count as a lookup.
+    bool MatchesPythonPool(absl::string_view encoded) {
+      auto name = EncodedFileDescriptorName(encoded);
+      if (!name) {
+        return false;
+      }
+      try {
+        auto file = pool_.attr("FindFileByName")(*name);
+        py::bytes serialized = file.attr("serialized_pb");
+        return PyBytesAsStringView(serialized) == encoded;
+      } catch (py::error_already_set& e) {
+        // The Python pool does not have this file; ignore it.
+        return false;
+      }
+    }
+
+    struct Snapshot {
+      std::unique_ptr<MappedFile> file;
+      // Indexes directly into file.
+      ::google::protobuf::EncodedDescriptorDatabase files;
+    };
+
+    // Returns true if find returns true for one of the snapshots, tried in
+    // the order they were added.
+    template <typename Find>
+    bool FindInSnapshots(Find find) {
+      for (const auto& snapshot : snapshots_) {
+        if (find(*snapshot)) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    bool CopyCachedFile(const std::string& filename,
+                        FileDescriptorProto* output) const {
+      auto it = files_.find(filename);
+      if (it == files_.end()) {
+        return false;
+      }
+      *output = it->second;
+      return true;
+    }
 
-      return output->ParsePartialFromString(
-          PyBytesAsStringView(py_file_descriptor.attr("serialized_pb")));
+    // Parses py_file and every file it transitively imports into files_,
+    // skipping files which are already cached, then copies py_file into
+    // output.
+    bool LoadFileClosure(py::handle py_file, FileDescriptorProto* output) {
+      auto filename = py_file.attr("name").cast<std::string>();
+      std::vector<py::object> pending = {
+          py::reinterpret_borrow<py::object>(py_file)};
+      while (!pending.empty()) {
+        py::object file = std::move(pending.back());
+        pending.pop_back();
+        auto name = file.attr("name").cast<std::string>();
+        if (files_.contains(name)) {
+          continue;
+        }
+        FileDescriptorProto file_proto;
+        if (!file_proto.ParsePartialFromString(
+                PyBytesAsStringView(file.attr("serialized_pb")))) {
+          return false;
+        }
+        files_.emplace(std::move(name), std::move(file_proto));
+        for (py::handle dependency : file.attr("dependencies")) {
+          pending.push_back(py::reinterpret_borrow<py::object>(dependency));
+        }
+      }
+      return CopyCachedFile(filename, output);
     }
 
     py::object pool_;  // never dereferenced.
+    uint64_t python_lookups_ = 0;
+
+    // Parsed files, indexed by file name. Only accessed with the GIL held.
+    absl::flat_hash_map<std::string, FileDescriptorProto> files_;
+
+    std::vector<std::unique_ptr<Snapshot>> snapshots_;
   };
 
+  // Returns a fingerprint of the canonical FileDescriptorProto of file,
+  // combined with the fingerprints of the files it imports. Equal
+  // fingerprints mean that the files, and everything they depend on, were
+  // built from identical definitions. The fingerprint is stable across
+  // processes.
+  uint64_t FileFingerprint(const FileDescriptor* file) {
+    auto it = file_fingerprints_.find(file);
+    if (it != file_fingerprints_.end()) {
+      return it->second;
+    }
+    FileDescriptorProto file_proto;
+    file->CopyTo(&file_proto);
+    // FileDescriptorProto has no map fields, so its serialization is
+    // deterministic.
+    uint64_t fingerprint = Fnv1a64(file_proto.SerializePartialAsString());
+    for (int i = 0; i < file->dependency_count(); ++i) {
+      uint64_t dependency = FileFingerprint(file->dependency(i));
+      fingerprint = Fnv1a64(
+          absl::string_view(reinterpret_cast<const char*>(&dependency),
+                            sizeof(dependency)),
+          fingerprint);
+    }
+    file_fingerprints_.emplace(file, fingerprint);
+    return fingerprint;
+  }
+
+  // 64-bit FNV-1a, used instead of absl::Hash because it is stable across
+  // processes.
+  static uint64_t Fnv1a64(absl::string_view data,
+                          uint64_t hash = 0xcbf29ce484222325ULL) {
+    for (unsigned char c : data) {
+      hash ^= c;
+      hash *= 0x100000001b3ULL;
+    }
+    return hash;
+  }
+
+  // Returns true if descriptor, or any message type reachable through its
+  // fields, declares extension ranges.
+  static bool MayContainExtensions(
+      const Descriptor* descriptor,
+      absl::flat_hash_set<const Descriptor*>* visited) {
+    if (!visited->insert(descriptor).second) {
+      return false;
+    }
+    if (descriptor->extension_range_count() > 0) {
+      return true;
+    }
+    for (int i = 0; i < descriptor->field_count(); ++i) {
+      const FieldDescriptor* field = descriptor->field(i);
+      if (field->cpp_type() == FieldDescriptor::CPPTYPE_MESSAGE &&
+          MayContainExtensions(field->message_type(), visited)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
   // This map caches the wrapped objects, indexed by DescriptorPool address.
   absl::flat_hash_map<PyObject*, Data> pools_map;
+
+  // Memoized FileFingerprint() results.
+  absl::flat_hash_map<const FileDescriptor*, uint64_t> file_fingerprints_;
+
+  // The reference to the Python message class keeps its address from being
+  // reused by another class. Prototypes live as long as their factory in
+  // pools_map, which is never cleared.
+  struct CachedPrototype {
+    py::object message_class;
+    const Message* prototype;
+  };
+
+  // This map caches prototypes, indexed by Python message class, so that
+  // repeated conversions skip the pool and factory lookups.
+  absl::flat_hash_map<PyTypeObject*, CachedPrototype> prototypes_by_class_;
 };
 
 }  // namespace
@@ -447,6 +981,50 @@ absl::string_view PyBytesAsStringView(py::bytes py_bytes) {
                            PyBytes_Size(py_bytes.ptr()));
 }
 
+absl::Cord PyBytesAsCord(py::bytes py_bytes) {
+  absl::string_view view = PyBytesAsStringView(py_bytes);
+  PyObject* owner = py_bytes.release().ptr();
+  return absl::MakeCordFromExternal(view, [owner](absl::string_view) {
+    if (!Py_IsInitialized()) {
+      // The object cannot be released during finalization; leak it.
+      return;
+    }
+    py::gil_scoped_acquire gil;
+    Py_DECREF(owner);
+  });
+}
+
+bool ParsePartialFromPyBytes(py::bytes serialized, Message* message) {
+  absl::string_view view = PyBytesAsStringView(serialized);
+  if (view.size() < kCordParseThreshold) {
+    return message->ParsePartialFromString(view);
+  }
+  return message->ParsePartialFromCord(PyBytesAsCord(std::move(serialized)));
+}
+
+bool ParsePartialFromPyBytesChecked(py::bytes serialized, Message* message) {
+  assert(PyGILState_Check());
+  if (!check_unknown_fields::ExtensionsWithUnknownFieldsPolicy::
+          UnknownFieldsAreChecked()) {
+    return ParsePartialFromPyBytes(std::move(serialized), message);
+  }
+  // The C++ pool wrapping the Python default pool resolves the extensions
+  // which Python knows.
+  const DescriptorPool* python_pool =
+      PythonDescriptorPoolWrapper::instance()
+          ->GetPoolFromPythonPool(GlobalState::instance()->global_pool())
+          ->pool.get();
+  absl::optional<std::string> error;
+  if (!check_unknown_fields::ParsePartialAndCheckSampled(
+          python_pool, PyBytesAsStringView(serialized), message, &error)) {
+    return false;
+  }
+  if (error) {
+    throw py::value_error(*error);
+  }
+  return true;
+}
+
 void InitializePybindProtoCastUtil() {
   assert(PyGILState_Check());
   GlobalState::instance();
@@ -539,26 +1117,257 @@ py::bytes PyProtoSerializePartialToString(py::handle py_proto,
   return serialized_bytes;
 }
 
-void CProtoCopyToPyProto(Message* message, py::handle py_proto) {
-  assert(PyGILState_Check());
+namespace {
+
+void MergeSerializedIntoPyProto(const Descriptor* descriptor,
+                                absl::string_view serialized,
+                                py::handle py_proto) {
   auto merge_fn = ResolveAttrMRO(py_proto, "MergeFromString");
   if (!merge_fn) {
     throw py::type_error(
         absl::StrCat("MergeFromString method not found; is this a ",
-                     message->GetDescriptor()->full_name()));
+                     descriptor->full_name()));
   }
 
-  auto serialized = message->SerializePartialAsString();
 #if PY_MAJOR_VERSION >= 3
   auto view = py::memoryview::from_memory(serialized.data(), serialized.size());
 #else
-  py::bytearray view(serialized);
+  py::bytearray view(std::string(serialized));
 #endif
   (*merge_fn)(view);
 }
 
+}  // namespace
+
+namespace {
+
+// Serialized messages at least this large are written to a buffer of their
+// own, mapped with a transparent huge page hint, rather than to the heap.
+std::atomic<size_t> large_conversion_threshold{size_t{64} << 20};
+
+std::atomic<uint64_t> large_conversion_buffers{0};
+std::atomic<uint64_t> large_conversion_bytes{0};
+std::atomic<uint64_t> large_conversion_bytes_in_use{0};
+
+// An anonymous memory mapping, unmapped when destroyed.
+class LargeConversionBuffer {
+ public:
+  // Returns nullptr if the mapping fails.
+  static std::unique_ptr<LargeConversionBuffer> Map(size_t size) {
+#if defined(_WIN32)
+    return nullptr;
+#else
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) return nullptr;
+#if defined(MADV_HUGEPAGE)
+    // Only a hint; fewer, larger page faults when the buffer is first written.
+    madvise(data, size, MADV_HUGEPAGE);
+#endif
+    large_conversion_buffers.fetch_add(1, std::memory_order_relaxed);
+    large_conversion_bytes.fetch_add(size, std::memory_order_relaxed);
+    large_conversion_bytes_in_use.fetch_add(size, std::memory_order_relaxed);
+    return absl::WrapUnique(
+        new LargeConversionBuffer(static_cast<uint8_t*>(data), size));
+#endif
+  }
+
+  LargeConversionBuffer(const LargeConversionBuffer&) = delete;
+  LargeConversionBuffer& operator=(const LargeConversionBuffer&) = delete;
+
+  ~LargeConversionBuffer() {
+#if !defined(_WIN32)
+    munmap(data_, size_);
+    large_conversion_bytes_in_use.fetch_sub(size_, std::memory_order_relaxed);
+#endif
+  }
+
+  uint8_t* data() const { return data_; }
+
+ private:
+  LargeConversionBuffer(uint8_t* data, size_t size)
+      : data_(data), size_(size) {}
+
+  uint8_t* data_;
+  size_t size_;
+};
+
+}  // namespace
+
+size_t SetLargeConversionThreshold(size_t bytes) {
+  return large_conversion_threshold.exchange(bytes, std::memory_order_relaxed);
+}
+
+LargeConversionStats GetLargeConversionStats() {
+  LargeConversionStats stats;
+  stats.buffers = large_conversion_buffers.load(std::memory_order_relaxed);
+  stats.bytes = large_conversion_bytes.load(std::memory_order_relaxed);
+  stats.bytes_in_use =
+      large_conversion_bytes_in_use.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void CProtoCopyToPyProto(Message* message, py::handle py_proto) {
+  assert(PyGILState_Check());
+  size_t size = message->ByteSizeLong();
+  if (size > static_cast<size_t>(INT_MAX)) {
+    // The cached sizes have overflowed, so the message cannot be serialized.
+    throw py::value_error(absl::StrCat(
+        "Message of type ", message->GetDescriptor()->full_name(), " is ",
+        size, " bytes, which exceeds the 2GB limit of serialized protos"));
+  }
+  if (size >= large_conversion_threshold.load(std::memory_order_relaxed)) {
+    if (auto buffer = LargeConversionBuffer::Map(size)) {
+      message->SerializeWithCachedSizesToArray(buffer->data());
+      MergeSerializedIntoPyProto(
+          message->GetDescriptor(),
+          absl::string_view(reinterpret_cast<const char*>(buffer->data()),
+                            size),
+          py_proto);
+      return;
+    }
+  }
+  std::string serialized(size, '\0');
+  message->SerializeWithCachedSizesToArray(
+      reinterpret_cast<uint8_t*>(&serialized[0]));
+  MergeSerializedIntoPyProto(message->GetDescriptor(), serialized, py_proto);
+}
+
+namespace {
+
+// Returns the serialization of a single field of message, whose sizes have
+// been cached by ByteSizeLong().
+std::string SerializeFieldWithCachedSizes(const Message& message,
+                                          const FieldDescriptor* field) {
+  std::string serialized;
+  {
+    ::google::protobuf::io::StringOutputStream stream(&serialized);
+    ::google::protobuf::io::CodedOutputStream coded(&stream);
+    coded.SetSerializationDeterministic(true);
+    ::google::protobuf::internal::WireFormat::SerializeFieldWithCachedSizes(
+        field, message, &coded);
+  }
+  return serialized;
+}
+
+py::object ResolvePyProtoMethod(py::handle py_proto, const char* name,
+                                const Descriptor* descriptor) {
+  auto method = ResolveAttrMRO(py_proto, name);
+  if (!method) {
+    throw py::type_error(absl::StrCat(name, " method not found; is this a ",
+                                      descriptor->full_name()));
+  }
+  return *method;
+}
+
+}  // namespace
+
+void PyProtoUpdateFromDiff(py::handle py_proto, const Message& before,
+                           const Message& after) {
+  assert(PyGILState_Check());
+  const Descriptor* descriptor = after.GetDescriptor();
+  const auto* reflection = after.GetReflection();
+  std::vector<const FieldDescriptor*> before_fields;
+  std::vector<const FieldDescriptor*> after_fields;
+  before.GetReflection()->ListFields(before, &before_fields);
+  reflection->ListFields(after, &after_fields);
+
+  // Extensions are cleared differently in Python, and unknown fields cannot
+  // be cleared individually; replace the whole message for either.
+  bool replace = false;
+  for (const auto* fields : {&before_fields, &after_fields}) {
+    for (const FieldDescriptor* field : *fields) {
+      if (field->is_extension()) replace = true;
+    }
+  }
+  if (!replace) {
+    std::string before_unknown;
+    std::string after_unknown;
+    before.GetReflection()->GetUnknownFields(before).SerializeToString(
+        &before_unknown);
+    reflection->GetUnknownFields(after).SerializeToString(&after_unknown);
+    replace = before_unknown != after_unknown;
+  }
+
+  std::vector<const FieldDescriptor*> cleared;
+  std::string changed;
+  if (!replace) {
+    before.ByteSizeLong();
+    after.ByteSizeLong();
+    // ListFields returns fields ordered by number.
+    auto b = before_fields.begin();
+    for (const FieldDescriptor* field : after_fields) {
+      for (; b != before_fields.end() && (*b)->number() < field->number();
+           ++b) {
+        cleared.push_back(*b);
+      }
+      bool in_before = b != before_fields.end() && *b == field;
+      if (in_before) ++b;
+      std::string serialized = SerializeFieldWithCachedSizes(after, field);
+      if (in_before &&
+          serialized == SerializeFieldWithCachedSizes(before, field)) {
+        continue;
+      }
+      // Merging a repeated or message field appends to it, so clear it
+      // first.
+      if (in_before && (field->is_repeated() ||
+                        field->cpp_type() == FieldDescriptor::CPPTYPE_MESSAGE)) {
+        cleared.push_back(field);
+      }
+      changed += serialized;
+    }
+    cleared.insert(cleared.end(), b, before_fields.end());
+  }
+
+  if (replace) {
+    ResolvePyProtoMethod(py_proto, "Clear", descriptor)();
+    MergeSerializedIntoPyProto(descriptor, after.SerializePartialAsString(),
+                               py_proto);
+    return;
+  }
+  if (!cleared.empty()) {
+    py::object clear_field =
+        ResolvePyProtoMethod(py_proto, "ClearField", descriptor);
+    for (const FieldDescriptor* field : cleared) {
+      clear_field(field->name());
+    }
+  }
+  if (!changed.empty()) {
+    MergeSerializedIntoPyProto(descriptor, changed, py_proto);
+  }
+}
+
+py::object PyProtoFromSerializedString(const Descriptor* descriptor,
+                                       absl::string_view serialized) {
+  assert(PyGILState_Check());
+  auto py_proto = GlobalState::instance()->PyMessageInstance(descriptor);
+  MergeSerializedIntoPyProto(descriptor, serialized, py_proto);
+  return py_proto;
+}
+
+void PyProtoMergeFromSerializedString(py::handle py_proto,
+                                      const Descriptor* descriptor,
+                                      absl::string_view serialized) {
+  assert(PyGILState_Check());
+  MergeSerializedIntoPyProto(descriptor, serialized, py_proto);
+}
+
+py::object PyProtoMessageClass(const Descriptor* descriptor) {
+  assert(PyGILState_Check());
+  return GlobalState::instance()->PyMessageClass(descriptor);
+}
+
+py::object PyProtoFromSerializedString(py::handle message_class,
+                                       const Descriptor* descriptor,
+                                       absl::string_view serialized) {
+  assert(PyGILState_Check());
+  auto py_proto = message_class();
+  MergeSerializedIntoPyProto(descriptor, serialized, py_proto);
+  return py_proto;
+}
+
 std::unique_ptr<Message> AllocateCProtoFromPythonSymbolDatabase(
-    py::handle src, const std::string& full_name) {
+    py::handle src, const std::string& full_name, bool prefer_generated) {
   assert(PyGILState_Check());
   auto pool = ResolveAttrs(src, {"DESCRIPTOR", "file", "pool"});
   if (!pool) {
@@ -576,13 +1385,303 @@ std::unique_ptr<Message> AllocateCProtoFromPythonSymbolDatabase(
   if (!descriptor) {
     throw py::type_error("Could not find descriptor: " + full_name);
   }
-  const Message* prototype = pool_data->factory->GetPrototype(descriptor);
+  const Message* prototype =
+      PythonDescriptorPoolWrapper::instance()->GetPrototype(
+          *pool_data, descriptor, prefer_generated);
   if (!prototype) {
     throw py::type_error("Unable to get prototype for " + full_name);
   }
+  // The cache serves generic loads, which need the pool's own type.
+  if (!prefer_generated) {
+    PythonDescriptorPoolWrapper::instance()->CachePrototype(src, prototype);
+  }
   return std::unique_ptr<Message>(prototype->New());
 }
 
+namespace testing {
+
+PythonDescriptorPoolStats GetPythonDescriptorPoolStats(
+    py::handle python_pool) {
+  assert(PyGILState_Check());
+  return PythonDescriptorPoolWrapper::instance()->GetStats(python_pool);
+}
+
+}  // namespace testing
+
+const Message* PyProtoGetCachedPrototype(py::handle src) {
+  assert(PyGILState_Check());
+  return PythonDescriptorPoolWrapper::instance()->FindCachedPrototype(src);
+}
+
+bool WritePythonDescriptorPoolSnapshot(py::handle python_pool,
+                                       const std::string& path,
+                                       absl::string_view fingerprint) {
+  assert(PyGILState_Check());
+  return PythonDescriptorPoolWrapper::instance()->WriteSnapshot(
+      python_pool, path, fingerprint);
+}
+
+bool LoadPythonDescriptorPoolSnapshot(py::handle python_pool,
+                                      const std::string& path,
+                                      absl::string_view fingerprint) {
+  assert(PyGILState_Check());
+  return PythonDescriptorPoolWrapper::instance()->LoadSnapshot(
+      python_pool, path, fingerprint);
+}
+
+void DefineDescriptorPoolSnapshots(py::module_& m) {
+  m.def(
+      "write_descriptor_pool_snapshot",
+      [](py::handle pool, const std::string& path,
+         const std::string& fingerprint) {
+        return WritePythonDescriptorPoolSnapshot(pool, path, fingerprint);
+      },
+      py::arg("pool"), py::arg("path"), py::arg("fingerprint"),
+      "Writes the files loaded from pool so far to path. Returns False if "
+      "the snapshot cannot be written.");
+  m.def(
+      "load_descriptor_pool_snapshot",
+      [](py::handle pool, const std::string& path,
+         const std::string& fingerprint) {
+        return LoadPythonDescriptorPoolSnapshot(pool, path, fingerprint);
+      },
+      py::arg("pool"), py::arg("path"), py::arg("fingerprint"),
+      "Uses the snapshot at path for the files of pool which it defines "
+      "identically. Returns False if it is missing, malformed, or was "
+      "written with another fingerprint.");
+}
+
+namespace {
+
+// The Python type of FrozenProto, once it has been registered. Guarded by the
+// GIL.
+PyTypeObject* frozen_proto_type = nullptr;
+
+PyTypeObject* FrozenProtoType(py::handle src) {
+  if (frozen_proto_type == nullptr) {
+    // Only pybind11 instances can be a FrozenProto; this check avoids a type
+    // registry lookup for every message before freeze() is first used.
+    if (!PyObject_TypeCheck(src.ptr(), reinterpret_cast<PyTypeObject*>(
+                                           py::detail::get_internals()
+                                               .instance_base))) {
+      return nullptr;
+    }
+    auto* info = py::detail::get_type_info(typeid(FrozenProto));
+    if (info != nullptr) frozen_proto_type = info->type;
+  }
+  return frozen_proto_type;
+}
+
+// Returns the Python message of a FrozenProto, converting messages frozen in
+// C++ on first use.
+py::object FrozenProtoSource(FrozenProto& self) {
+  if (!self.source) {
+    self.source = PyProtoFromSerializedString(
+        self.message->GetDescriptor(), self.message->SerializePartialAsString());
+  }
+  return self.source;
+}
+
+// Returns a FrozenProto for message, a part of owner's message.
+py::object FrozenSubmessage(const std::shared_ptr<const Message>& owner,
+                            const Message& message) {
+  return py::cast(FrozenProto{std::shared_ptr<const Message>(owner, &message),
+                              py::object()});
+}
+
+// Returns the value of a singular field, or of element index of a repeated
+// field, as a Python value; messages are FrozenProtos sharing owner.
+py::object FrozenFieldValue(const std::shared_ptr<const Message>& owner,
+                            const Message& message,
+                            const FieldDescriptor* field, int index) {
+  const Reflection& reflection = *message.GetReflection();
+  const bool repeated = field->is_repeated();
+  switch (field->cpp_type()) {
+    case FieldDescriptor::CPPTYPE_INT32:
+      return py::int_(repeated
+                          ? reflection.GetRepeatedInt32(message, field, index)
+                          : reflection.GetInt32(message, field));
+    case FieldDescriptor::CPPTYPE_INT64:
+      return py::int_(repeated
+                          ? reflection.GetRepeatedInt64(message, field, index)
+                          : reflection.GetInt64(message, field));
+    case FieldDescriptor::CPPTYPE_UINT32:
+      return py::int_(repeated
+                          ? reflection.GetRepeatedUInt32(message, field, index)
+                          : reflection.GetUInt32(message, field));
+    case FieldDescriptor::CPPTYPE_UINT64:
+      return py::int_(repeated
+                          ? reflection.GetRepeatedUInt64(message, field, index)
+                          : reflection.GetUInt64(message, field));
+    case FieldDescriptor::CPPTYPE_DOUBLE:
+      return py::float_(
+          repeated ? reflection.GetRepeatedDouble(message, field, index)
+                   : reflection.GetDouble(message, field));
+    case FieldDescriptor::CPPTYPE_FLOAT:
+      return py::float_(
+          repeated ? reflection.GetRepeatedFloat(message, field, index)
+                   : reflection.GetFloat(message, field));
+    case FieldDescriptor::CPPTYPE_BOOL:
+      return py::bool_(repeated
+                           ? reflection.GetRepeatedBool(message, field, index)
+                           : reflection.GetBool(message, field));
+    case FieldDescriptor::CPPTYPE_ENUM:
+      // Like Python messages, enum fields are ints.
+      return py::int_(
+          repeated ? reflection.GetRepeatedEnumValue(message, field, index)
+                   : reflection.GetEnumValue(message, field));
+    case FieldDescriptor::CPPTYPE_STRING: {
+      std::string scratch;
+      const std::string& value =
+          repeated ? reflection.GetRepeatedStringReference(message, field,
+                                                           index, &scratch)
+                   : reflection.GetStringReference(message, field, &scratch);
+      if (field->type() == FieldDescriptor::TYPE_BYTES) {
+        return py::bytes(value);
+      }
+      return py::str(value);
+    }
+    case FieldDescriptor::CPPTYPE_MESSAGE:
+      return FrozenSubmessage(
+          owner, repeated ? reflection.GetRepeatedMessage(message, field, index)
+                          : reflection.GetMessage(message, field));
+  }
+  throw py::type_error(
+      absl::StrCat("Unsupported type of field ", field->full_name()));
+}
+
+// FrozenMessage.__getattr__: reads fields of the C++ message through
+// reflection, so that reading a few fields does not convert the whole message
+// to Python. Repeated fields are lists, and map fields dicts. Other attributes
+// are those of the Python message.
+py::object FrozenProtoGetAttr(FrozenProto& self, const std::string& name) {
+  const Message& message = *self.message;
+  const FieldDescriptor* field =
+      message.GetDescriptor()->FindFieldByName(name);
+  if (field == nullptr) {
+    return FrozenProtoSource(self).attr(name.c_str());
+  }
+  if (!field->is_repeated()) {
+    return FrozenFieldValue(self.message, message, field, -1);
+  }
+  const Reflection& reflection = *message.GetReflection();
+  int size = reflection.FieldSize(message, field);
+  if (field->is_map()) {
+    const FieldDescriptor* key_field = field->message_type()->map_key();
+    const FieldDescriptor* value_field = field->message_type()->map_value();
+    py::dict result;
+    for (int i = 0; i < size; ++i) {
+      const Message& entry = reflection.GetRepeatedMessage(message, field, i);
+      result[FrozenFieldValue(self.message, entry, key_field, -1)] =
+          FrozenFieldValue(self.message, entry, value_field, -1);
+    }
+    return std::move(result);
+  }
+  py::list result(size);
+  for (int i = 0; i < size; ++i) {
+    result[i] = FrozenFieldValue(self.message, message, field, i);
+  }
+  return std::move(result);
+}
+
+// Returns the FrozenMessage class, defining it on first use.
+py::handle FrozenProtoClass() {
+  if (auto* info = py::detail::get_type_info(typeid(FrozenProto))) {
+    return py::handle(reinterpret_cast<PyObject*>(info->type));
+  }
+  // The class belongs to no extension module; its scope is kept alive like
+  // GlobalState.
+  static py::module_* scope = new py::module_(
+      py::reinterpret_steal<py::module_>(PyModule_New("pybind11_protobuf")));
+  return py::class_<FrozenProto>(
+             *scope, "FrozenMessage",
+             "A C++ message, which C++ functions taking the message use "
+             "without converting it again. Fields can be read directly; "
+             "changes to the original message are not reflected.")
+      .def_property_readonly("message", &FrozenProtoSource,
+                             "The message which was frozen, or a Python copy "
+                             "of a message frozen in C++.")
+      .def_property_readonly("DESCRIPTOR",
+                             [](FrozenProto& self) {
+                               return FrozenProtoSource(self).attr(
+                                   "DESCRIPTOR");
+                             })
+      .def("SerializePartialToString",
+           [](const FrozenProto& self) {
+             return py::bytes(self.message->SerializePartialAsString());
+           })
+      .def("__getattr__", &FrozenProtoGetAttr, py::arg("name"))
+      .def("__repr__",
+           [](FrozenProto& self) {
+             return absl::StrCat(
+                 "FrozenMessage(",
+                 py::repr(FrozenProtoSource(self)).cast<std::string>(), ")");
+           })
+      .release();
+}
+
+}  // namespace
+
+const Message* PyFrozenProtoGetMessage(py::handle src) {
+  assert(PyGILState_Check());
+  PyTypeObject* type = FrozenProtoType(src);
+  if (type == nullptr || Py_TYPE(src.ptr()) != type) return nullptr;
+  return src.cast<const FrozenProto&>().message.get();
+}
+
+py::object PyProtoFreeze(py::handle py_proto) {
+  assert(PyGILState_Check());
+  if (PyFrozenProtoGetMessage(py_proto)) {
+    return py::reinterpret_borrow<py::object>(py_proto);
+  }
+  std::unique_ptr<Message> message;
+  if (const Message* cpp_message = PyProtoGetCppMessagePointer(py_proto)) {
+    message.reset(cpp_message->New());
+    message->CopyFrom(*cpp_message);
+  } else {
+    auto full_name = PyProtoDescriptorFullName(py_proto);
+    if (!full_name) {
+      throw py::type_error(absl::StrCat(
+          "freeze() expects a protocol buffer message, got ",
+          py::repr(py_proto).cast<std::string>()));
+    }
+    // Prefer the generated type, which the casters for generated types can
+    // use without a copy. Messages of other pools only use it when their
+    // type is identical.
+    const Descriptor* descriptor =
+        DescriptorPool::generated_pool()->FindMessageTypeByName(*full_name);
+    auto pool = ResolveAttrs(py_proto, {"DESCRIPTOR", "file", "pool"});
+    if (descriptor != nullptr &&
+        (!pool || pool->is(GlobalState::instance()->global_pool()))) {
+      message.reset(
+          MessageFactory::generated_factory()->GetPrototype(descriptor)->New());
+    } else {
+      message = AllocateCProtoFromPythonSymbolDatabase(
+          py_proto, *full_name, /*prefer_generated=*/true);
+    }
+    py::bytes serialized =
+        PyProtoSerializePartialToString(py_proto, /*raise_if_error=*/true);
+    if (!ParsePartialFromPyBytes(std::move(serialized), message.get())) {
+      throw py::type_error(absl::StrCat("Failed to parse ", *full_name));
+    }
+  }
+  return py::cast(FrozenProto{std::shared_ptr<const Message>(std::move(message)),
+                              py::reinterpret_borrow<py::object>(py_proto)});
+}
+
+py::object PyFrozenProtoFromMessage(std::shared_ptr<const Message> message) {
+  assert(PyGILState_Check());
+  if (!message) return py::none();
+  FrozenProtoClass();
+  return py::cast(FrozenProto{std::move(message), py::object()});
+}
+
+void DefineFrozenProtos(py::module_& m) {
+  m.attr("FrozenMessage") = FrozenProtoClass();
+  m.def("freeze", &PyProtoFreeze, py::arg("message"),
+        "Returns a FrozenMessage holding a C++ copy of message.");
+}
+
 namespace {
 
 std::string ReturnValuePolicyName(py::return_value_policy policy) {
@@ -616,10 +1715,122 @@ std::string ReturnValuePolicyName(py::return_value_policy policy) {
 
 }  // namespace
 
+namespace {
+
+// Least recently used Python messages of one type, keyed by the interning key
+// of their C++ message. Guarded by the GIL.
+class ProtoInternCache {
+ public:
+  ProtoInternCache(size_t capacity, ProtoInternKeyFn key)
+      : capacity_(capacity), key_(std::move(key)) {}
+
+  void Reset(size_t capacity, ProtoInternKeyFn key) {
+    capacity_ = capacity;
+    // Keys of the previous function need not match the new one.
+    key_ = std::move(key);
+    lru_.clear();
+    by_key_.clear();
+    stats_.size = 0;
+  }
+
+  const ProtoInternStats& stats() const { return stats_; }
+
+  // Returns a new Python message with the content of src, copied from the
+  // cache when its key was converted recently. Returns a null object if src
+  // has no key.
+  py::object Convert(const Message& src) {
+    absl::optional<std::string> key = key_(src);
+    if (!key) return py::object();
+    const Descriptor* descriptor = src.GetDescriptor();
+    // The cached message is never handed out, so callers may modify the
+    // result.
+    py::object py_proto =
+        GlobalState::instance()->PyMessageInstance(descriptor);
+    auto found = by_key_.find(*key);
+    if (found != by_key_.end()) {
+      ++stats_.hits;
+      lru_.splice(lru_.begin(), lru_, found->second);
+      py_proto.attr("CopyFrom")(found->second->py_proto);
+      return py_proto;
+    }
+
+    ++stats_.misses;
+    CProtoCopyToPyProto(const_cast<Message*>(&src), py_proto);
+    py::object cached = GlobalState::instance()->PyMessageInstance(descriptor);
+    cached.attr("CopyFrom")(py_proto);
+    lru_.push_front(Entry{*key, std::move(cached)});
+    by_key_.emplace(std::move(*key), lru_.begin());
+    while (lru_.size() > capacity_) Evict();
+    stats_.size = lru_.size();
+    return py_proto;
+  }
+
+ private:
+  struct Entry {
+    std::string key;
+    py::object py_proto;
+  };
+
+  void Evict() {
+    by_key_.erase(lru_.back().key);
+    lru_.pop_back();
+    ++stats_.evictions;
+    stats_.size = lru_.size();
+  }
+
+  size_t capacity_;
+  ProtoInternKeyFn key_;
+  std::list<Entry> lru_;
+  absl::flat_hash_map<std::string, std::list<Entry>::iterator> by_key_;
+  ProtoInternStats stats_;
+};
+
+// Interning caches by message type. Guarded by the GIL, and intentionally
+// leaked, like GlobalState.
+absl::flat_hash_map<const Descriptor*, ProtoInternCache*>& ProtoInternCaches() {
+  static auto* caches =
+      new absl::flat_hash_map<const Descriptor*, ProtoInternCache*>();
+  return *caches;
+}
+
+}  // namespace
+
+void EnableProtoResultInterning(const Descriptor* descriptor, size_t capacity,
+                                ProtoInternKeyFn key) {
+  assert(PyGILState_Check());
+  auto& caches = ProtoInternCaches();
+  auto it = caches.find(descriptor);
+  if (capacity == 0) {
+    if (it != caches.end()) {
+      delete it->second;
+      caches.erase(it);
+    }
+  } else if (it != caches.end()) {
+    it->second->Reset(capacity, std::move(key));
+  } else {
+    caches.emplace(descriptor, new ProtoInternCache(capacity, std::move(key)));
+  }
+}
+
+ProtoInternStats GetProtoResultInterningStats(const Descriptor* descriptor) {
+  assert(PyGILState_Check());
+  auto& caches = ProtoInternCaches();
+  auto it = caches.find(descriptor);
+  return it != caches.end() ? it->second->stats() : ProtoInternStats();
+}
+
 py::handle GenericPyProtoCast(Message* src, py::return_value_policy policy,
                               py::handle parent, bool is_const) {
   assert(src != nullptr);
   assert(PyGILState_Check());
+  auto& caches = ProtoInternCaches();
+  if (!caches.empty()) {
+    auto it = caches.find(src->GetDescriptor());
+    if (it != caches.end()) {
+      py::object interned = it->second->Convert(*src);
+      if (interned) return interned.release();
+    }
+  }
   auto py_proto =
       GlobalState::instance()->PyMessageInstance(src->GetDescriptor());
 
@@ -6,9 +6,13 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/pytypes.h>
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
 
+#include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include "google/protobuf/descriptor.h"
@@ -45,6 +49,25 @@ std::string InferPythonModuleNameFromDescriptorFileName(
 // returned string_view.
 absl::string_view PyBytesAsStringView(pybind11::bytes py_bytes);
 
+// Returns a Cord sharing the buffer of py_bytes, which it keeps alive. The
+// Cord may be copied and destroyed on any thread; releasing the last copy
+// takes the GIL.
+absl::Cord PyBytesAsCord(pybind11::bytes py_bytes);
+
+// Parses serialized into message. Large inputs are parsed from a Cord sharing
+// the buffer of serialized, so that Cord ([ctype=CORD]) fields reference it
+// rather than copy their contents.
+bool ParsePartialFromPyBytes(pybind11::bytes serialized,
+                             ::google::protobuf::Message *message);
+
+// Parses serialized into message like ParsePartialFromPyBytes. When unknown
+// fields are checked (see check_unknown_fields::
+// ExtensionsWithUnknownFieldsPolicy), throws pybind11::value_error if the
+// message has an unknown field which Python knows as an extension, i.e. its
+// cc_proto_library is not linked in.
+bool ParsePartialFromPyBytesChecked(pybind11::bytes serialized,
+                                    ::google::protobuf::Message *message);
+
 // Initialize internal proto cast dependencies, which includes importing
 // various protobuf-related modules.
 void InitializePybindProtoCastUtil();
@@ -55,6 +78,34 @@ void ImportProtoDescriptorModule(const ::google::protobuf::Descriptor *);
 // Returns a ::google::protobuf::Message* from a cpp_fast_proto, if backed by C++.
 const ::google::protobuf::Message *PyProtoGetCppMessagePointer(pybind11::handle src);
 
+// A message converted to C++ once by freeze(), so that passing it to C++
+// again does not serialize and parse it. Bound as FrozenMessage by
+// DefineFrozenProtos.
+struct FrozenProto {
+  std::shared_ptr<const ::google::protobuf::Message> message;
+  // The Python message it was converted from. Null for a message frozen in
+  // C++ until its Python copy is first requested.
+  pybind11::object source;
+};
+
+// Returns the C++ message of a FrozenMessage, or nullptr if src is not one.
+const ::google::protobuf::Message *PyFrozenProtoGetMessage(pybind11::handle src);
+
+// Returns a FrozenMessage holding a C++ copy of py_proto, or py_proto itself
+// if it is already frozen.
+pybind11::object PyProtoFreeze(pybind11::handle py_proto);
+
+// Returns a FrozenMessage holding message, which may share ownership of a
+// larger object such as an Arena, or None if message is null. Defines the
+// FrozenMessage class if no module has yet.
+pybind11::object PyFrozenProtoFromMessage(
+    std::shared_ptr<const ::google::protobuf::Message> message);
+
+// Defines FrozenMessage and freeze(message) in m. The class is registered
+// once per process and shared by all modules which define it. Fields of a
+// FrozenMessage are read from its C++ message.
+void DefineFrozenProtos(pybind11::module_ &m);
+
 // Returns the protocol buffer's py_proto.DESCRIPTOR.full_name attribute.
 absl::optional<std::string> PyProtoDescriptorFullName(
     pybind11::handle py_proto);
@@ -67,14 +118,135 @@ bool PyProtoHasMatchingFullName(pybind11::handle py_proto,
 pybind11::bytes PyProtoSerializePartialToString(pybind11::handle py_proto,
                                                 bool raise_if_error);
 
-// Allocates a C++ protocol buffer for a given name.
+// Allocates a C++ protocol buffer for a given name, from the C++ pool wrapping
+// the Python pool of src. The message type belongs to that pool, unless
+// prefer_generated is true and the type is identical to a C++ generated type
+// of the same name, in which case the generated type is used.
 std::unique_ptr<::google::protobuf::Message> AllocateCProtoFromPythonSymbolDatabase(
-    pybind11::handle src, const std::string &full_name);
+    pybind11::handle src, const std::string &full_name,
+    bool prefer_generated = false);
+
+// Returns the prototype found by AllocateCProtoFromPythonSymbolDatabase for
+// the Python message class of src, or nullptr if no instance of that class
+// has been allocated yet. The ::google::protobuf::Message caster uses it to
+// skip the descriptor and pool lookups when it loads a class again.
+const ::google::protobuf::Message *PyProtoGetCachedPrototype(pybind11::handle src);
+
+// Writes the files which the C++ pool wrapping python_pool has loaded so far
+// to path, as a serialized FileDescriptorSet sorted by file name, preceded by
+// fingerprint. The fingerprint identifies the contents of python_pool, e.g.
+// a build id or a hash of the versions of the modules defining its files.
+// Returns false if the snapshot cannot be written.
+bool WritePythonDescriptorPoolSnapshot(pybind11::handle python_pool,
+                                       const std::string &path,
+                                       absl::string_view fingerprint);
+
+// Memory-maps a snapshot written by WritePythonDescriptorPoolSnapshot, so that
+// the C++ pool wrapping python_pool builds the files it contains without
+// calling back into Python for each of them. Only files which the C++ pool
+// has not built yet are affected, so call this before the first conversion.
+// A snapshot written with another fingerprint is rejected as a whole. Each
+// file of an accepted snapshot is compared with the serialized_pb of the file
+// of the same name in python_pool, without parsing either, and only used if
+// they are identical; python_pool serves the other files. Returns false,
+// without using the snapshot, if path is not a readable snapshot, was written
+// with another fingerprint, or defines a file or symbol twice.
+bool LoadPythonDescriptorPoolSnapshot(pybind11::handle python_pool,
+                                      const std::string &path,
+                                      absl::string_view fingerprint);
+
+// Defines write_descriptor_pool_snapshot(pool, path, fingerprint) and
+// load_descriptor_pool_snapshot(pool, path, fingerprint) in m.
+void DefineDescriptorPoolSnapshots(pybind11::module_ &m);
+
+// Memory used by C++ -> Python conversions of large messages.
+struct LargeConversionStats {
+  // Number of serialization buffers mapped, and their total size.
+  uint64_t buffers = 0;
+  uint64_t bytes = 0;
+  // Size of the buffers currently mapped.
+  uint64_t bytes_in_use = 0;
+};
+
+// Sets the serialized size from which CProtoCopyToPyProto serializes into a
+// dedicated memory mapping with a transparent huge page hint, unmapped as
+// soon as Python has parsed it, instead of a heap buffer. Returns the
+// previous threshold. Thread-safe.
+//
+// This only covers the serialization buffer, which is at most 2GB: larger
+// messages cannot be serialized, and are rejected with ValueError. The
+// messages themselves, and arena blocks in particular, are allocated as
+// usual.
+size_t SetLargeConversionThreshold(size_t bytes);
+
+// Returns the counters for large conversions since the process started.
+LargeConversionStats GetLargeConversionStats();
 
 // Serialize the py_proto and deserialize it into the provided message.
-// Caller should enforce any type identity that is required.
+// Caller should enforce any type identity that is required. Throws
+// pybind11::value_error if message serializes to more than 2GB.
 void CProtoCopyToPyProto(::google::protobuf::Message *message, pybind11::handle py_proto);
 
+// Updates py_proto, from which before was converted, to match after, a
+// modified copy of before. Only the fields that differ are written: fields
+// after no longer has are cleared, and changed fields are merged in a single
+// MergeFromString call. Falls back to replacing the whole message when
+// extensions or unknown fields changed.
+void PyProtoUpdateFromDiff(pybind11::handle py_proto,
+                           const ::google::protobuf::Message &before,
+                           const ::google::protobuf::Message &after);
+
+// Returns a new Python message of the given type, parsed from serialized.
+// This is the Python half of GenericPyProtoCast, for callers which serialize
+// the C++ message without holding the GIL.
+pybind11::object PyProtoFromSerializedString(
+    const ::google::protobuf::Descriptor *descriptor, absl::string_view serialized);
+
+// Merges serialized, a message of the given type, into py_proto.
+void PyProtoMergeFromSerializedString(
+    pybind11::handle py_proto, const ::google::protobuf::Descriptor *descriptor,
+    absl::string_view serialized);
+
+// Returns the Python message class for descriptor. Callers converting many
+// messages of the same type can look the class up once and pass it to the
+// PyProtoFromSerializedString overload below.
+pybind11::object PyProtoMessageClass(
+    const ::google::protobuf::Descriptor *descriptor);
+
+// As above, for a message_class returned by PyProtoMessageClass(descriptor).
+pybind11::object PyProtoFromSerializedString(
+    pybind11::handle message_class,
+    const ::google::protobuf::Descriptor *descriptor, absl::string_view serialized);
+
+// Statistics of the interning cache for one message type.
+struct ProtoInternStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+  size_t size = 0;
+};
+
+// Returns the interning key of a message, or nullopt to convert it without the
+// cache. Messages with equal keys must have equal contents. Called with the
+// GIL held, on every conversion of the type, so it should be cheap, e.g. an id
+// field of the message.
+using ProtoInternKeyFn = std::function<absl::optional<std::string>(
+    const ::google::protobuf::Message &)>;
+
+// Makes C++ -> Python conversions of messages of the given type return a copy
+// of a cached Python message when a message with the same key was converted
+// recently, instead of serializing it and parsing it again in Python. The
+// cache holds up to capacity messages and evicts the least recently used.
+// Enabling it again drops the cached messages. A capacity of 0 disables
+// interning. Suits types whose values repeat, such as defaults and lookup
+// tables.
+void EnableProtoResultInterning(const ::google::protobuf::Descriptor *descriptor,
+                                size_t capacity, ProtoInternKeyFn key);
+
+// Returns the statistics for descriptor since interning was enabled.
+ProtoInternStats GetProtoResultInterningStats(
+    const ::google::protobuf::Descriptor *descriptor);
+
 // Returns a handle to a python protobuf suitably
 pybind11::handle GenericFastCppProtoCast(::google::protobuf::Message *src,
                                          pybind11::return_value_policy policy,
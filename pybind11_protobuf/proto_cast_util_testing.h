@@ -0,0 +1,30 @@
+// Hooks for tests to inspect the state kept by proto_cast_util.cc. They are
+// not part of the caster API.
+
+#ifndef PYBIND11_PROTOBUF_PROTO_CAST_UTIL_TESTING_H_
+#define PYBIND11_PROTOBUF_PROTO_CAST_UTIL_TESTING_H_
+
+#include <pybind11/pybind11.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace pybind11_protobuf::testing {
+
+// The state of the C++ pool wrapping a Python DescriptorPool.
+struct PythonDescriptorPoolStats {
+  // Names of the files loaded from the Python pool or from snapshots, sorted.
+  std::vector<std::string> file_names;
+  // Number of lookups made into the Python pool; each one loads the whole
+  // dependency closure of the file found.
+  uint64_t python_lookups = 0;
+};
+
+// Returns the state of the C++ pool wrapping python_pool.
+PythonDescriptorPoolStats GetPythonDescriptorPoolStats(
+    pybind11::handle python_pool);
+
+}  // namespace pybind11_protobuf::testing
+
+#endif  // PYBIND11_PROTOBUF_PROTO_CAST_UTIL_TESTING_H_
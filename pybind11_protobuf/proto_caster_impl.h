@@ -45,6 +45,11 @@ struct proto_caster_load_impl {
       value = nullptr;
       return true;
     }
+    // A FrozenMessage was converted by freeze(); use its C++ message.
+    if (const ::google::protobuf::Message *frozen =
+            PyFrozenProtoGetMessage(src)) {
+      return load_frozen(*frozen);
+    }
     // NOTE: We might need to know whether the proto has extensions that
     // are python-only.
 
@@ -72,7 +77,49 @@ struct proto_caster_load_impl {
 
     owned = std::unique_ptr<ProtoType>(new ProtoType());
     value = owned.get();
-    return owned->ParsePartialFromString(PyBytesAsStringView(serialized_bytes));
+    return ParsePartialFromPyBytesChecked(std::move(serialized_bytes),
+                                          owned.get());
+  }
+
+  // load_into converts from Python -> C++ like load, but stores the result
+  // in dest, so that callers can parse directly into their final storage
+  // rather than copying or moving from owned. Unlike load, None is rejected.
+  static bool load_into(pybind11::handle src, bool convert, ProtoType *dest) {
+    if (src.is_none()) {
+      return false;
+    }
+    const ::google::protobuf::Message *message =
+        PyFrozenProtoGetMessage(src);
+    if (!message) {
+      message = pybind11_protobuf::PyProtoGetCppMessagePointer(src);
+    }
+    if (message) {
+      const ProtoType *cpp_value =
+          ::google::protobuf::DynamicCastToGenerated<ProtoType>(message);
+      if (cpp_value) {
+        // The Python object keeps ownership, so this has to be a copy.
+        *dest = *cpp_value;
+        return true;
+      }
+      if (message->GetDescriptor()->full_name() ==
+          ProtoType::GetDescriptor()->full_name()) {
+        // A frozen message built from a different descriptor pool.
+        dest->Clear();
+        return dest->ParsePartialFromString(
+            message->SerializePartialAsString());
+      }
+    }
+
+    if (!PyProtoHasMatchingFullName(src, ProtoType::GetDescriptor())) {
+      return false;
+    }
+    pybind11::bytes serialized_bytes =
+        PyProtoSerializePartialToString(src, convert);
+    if (!serialized_bytes) {
+      return false;
+    }
+    dest->Clear();
+    return ParsePartialFromPyBytesChecked(std::move(serialized_bytes), dest);
   }
 
   // ensure_owned ensures that the owned member contains a copy of the
@@ -87,6 +134,23 @@ struct proto_caster_load_impl {
 
   const ProtoType *value;
   std::unique_ptr<ProtoType> owned;
+
+ private:
+  bool load_frozen(const ::google::protobuf::Message &frozen) {
+    value = ::google::protobuf::DynamicCastToGenerated<ProtoType>(&frozen);
+    if (value) {
+      return true;
+    }
+    // The message was frozen as a dynamic message, e.g. because the
+    // generated type was not linked in at the time.
+    if (frozen.GetDescriptor()->full_name() !=
+        ProtoType::GetDescriptor()->full_name()) {
+      return false;
+    }
+    owned = std::unique_ptr<ProtoType>(new ProtoType());
+    value = owned.get();
+    return owned->ParsePartialFromString(frozen.SerializePartialAsString());
+  }
 };
 
 template <>
@@ -99,6 +163,12 @@ struct proto_caster_load_impl<::google::protobuf::Message> {
       return true;
     }
 
+    // A FrozenMessage was converted by freeze(); use its C++ message.
+    value = PyFrozenProtoGetMessage(src);
+    if (value) {
+      return true;
+    }
+
     // Attempt to use the PyProto_API to get an underlying C++ message pointer
     // from the object.
     value = pybind11_protobuf::PyProtoGetCppMessagePointer(src);
@@ -107,10 +177,17 @@ struct proto_caster_load_impl<::google::protobuf::Message> {
     }
 
     // `src` is not a C++ proto instance from the generated_pool,
-    // so create a compatible native C++ proto.
-    auto descriptor_name = pybind11_protobuf::PyProtoDescriptorFullName(src);
-    if (!descriptor_name) {
-      return false;
+    // so create a compatible native C++ proto. Once a Python message class
+    // has been converted, its prototype is cached and the descriptor lookup
+    // is skipped.
+    const ProtoType *prototype =
+        pybind11_protobuf::PyProtoGetCachedPrototype(src);
+    absl::optional<std::string> descriptor_name;
+    if (!prototype) {
+      descriptor_name = pybind11_protobuf::PyProtoDescriptorFullName(src);
+      if (!descriptor_name) {
+        return false;
+      }
     }
     pybind11::bytes serialized_bytes =
         PyProtoSerializePartialToString(src, convert);
@@ -118,12 +195,16 @@ struct proto_caster_load_impl<::google::protobuf::Message> {
       return false;
     }
 
-    owned.reset(static_cast<ProtoType *>(
-        pybind11_protobuf::AllocateCProtoFromPythonSymbolDatabase(
-            src, *descriptor_name)
-            .release()));
+    if (prototype) {
+      owned.reset(prototype->New());
+    } else {
+      owned.reset(static_cast<ProtoType *>(
+          pybind11_protobuf::AllocateCProtoFromPythonSymbolDatabase(
+              src, *descriptor_name)
+              .release()));
+    }
     value = owned.get();
-    return owned->ParsePartialFromString(PyBytesAsStringView(serialized_bytes));
+    return ParsePartialFromPyBytes(std::move(serialized_bytes), owned.get());
   }
 
   // ensure_owned ensures that the owned member contains a copy of the
@@ -0,0 +1,189 @@
+#ifndef PYBIND11_PROTOBUF_PROTO_FN_H_
+#define PYBIND11_PROTOBUF_PROTO_FN_H_
+
+#include <pybind11/cast.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/pytypes.h>
+
+#include <Python.h>
+
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "google/protobuf/message.h"
+#include "pybind11_protobuf/native_proto_caster.h"
+
+// def_proto_fn registers a function whose parameters and result are protos,
+// arithmetic types or std::string as a CPython METH_FASTCALL function, which
+// calls the type casters directly instead of going through the pybind11
+// dispatcher. For small messages this removes a large part of the fixed cost
+// of a call: the argument vectors, overload iteration and loader_life_support.
+//
+// The resulting function has a single signature and takes positional
+// arguments only. Exceptions are translated by the registered pybind11
+// exception translators, as for m.def().
+//
+// Example:
+//
+// #include "pybind11_protobuf/proto_fn.h"
+//
+// PYBIND11_MODULE(my_module, m) {
+//   pybind11_protobuf::ImportNativeProtoCasters();
+//
+//   pybind11_protobuf::def_proto_fn(
+//       m, "lookup", [](const LookupRequest& request, int32_t limit) {
+//         return Lookup(request, limit);
+//       });
+// }
+
+namespace pybind11_protobuf {
+namespace impl {
+
+// Types which def_proto_fn converts without loader_life_support.
+template <typename T>
+struct IsProtoFnType {
+  using type = pybind11::detail::intrinsic_t<T>;
+  static constexpr bool value =
+      std::is_base_of<::google::protobuf::Message, type>::value ||
+      std::is_arithmetic<type>::value || std::is_same<type, std::string>::value;
+};
+
+template <typename R>
+struct IsProtoFnResult
+    : std::integral_constant<bool, std::is_void<R>::value ||
+                                       (IsProtoFnType<R>::value &&
+                                        !std::is_pointer<R>::value &&
+                                        !std::is_reference<R>::value)> {};
+
+// Raises the current exception as a Python error, consulting the same
+// translators as the pybind11 dispatcher.
+inline void TranslateProtoFnException() {
+  if (pybind11::detail::apply_exception_translators(
+          pybind11::detail::get_local_internals()
+              .registered_exception_translators) ||
+      pybind11::detail::apply_exception_translators(
+          pybind11::detail::get_internals().registered_exception_translators)) {
+    return;
+  }
+  PyErr_SetString(PyExc_SystemError,
+                  "Exception escaped from default exception translator!");
+}
+
+template <typename F, typename Signature>
+struct ProtoFn;
+
+template <typename F, typename R, typename... Args>
+struct ProtoFn<F, R(Args...)> {
+  static_assert(IsProtoFnResult<R>::value,
+                "def_proto_fn functions must return void, a proto, an "
+                "arithmetic type or std::string by value");
+  static_assert((IsProtoFnType<Args>::value && ...),
+                "def_proto_fn parameters must be protos, arithmetic types or "
+                "std::string");
+
+  struct State {
+    F f;
+    std::string name;
+  };
+
+  static PyObject* Call(PyObject* self, PyObject* const* args,
+                        Py_ssize_t nargs) {
+    State* state = pybind11::reinterpret_borrow<pybind11::capsule>(self)
+                       .template get_pointer<State>();
+    if (nargs != static_cast<Py_ssize_t>(sizeof...(Args))) {
+      PyErr_Format(PyExc_TypeError,
+                   "%s() takes %zd positional arguments but %zd were given",
+                   state->name.c_str(),
+                   static_cast<Py_ssize_t>(sizeof...(Args)), nargs);
+      return nullptr;
+    }
+    try {
+      return Invoke(*state, args, std::index_sequence_for<Args...>{});
+    } catch (...) {
+      TranslateProtoFnException();
+      return nullptr;
+    }
+  }
+
+  template <size_t... Is>
+  static PyObject* Invoke(State& state, PyObject* const* args,
+                          std::index_sequence<Is...>) {
+    std::tuple<pybind11::detail::make_caster<Args>...> casters;
+    const bool loaded[] = {
+        true, std::get<Is>(casters).load(pybind11::handle(args[Is]), true)...};
+    for (size_t i = 0; i < sizeof...(Args); ++i) {
+      if (!loaded[i + 1]) {
+        const std::string type_names[] = {
+            std::string(), pybind11::type_id<pybind11::detail::intrinsic_t<
+                               Args>>()...};
+        throw pybind11::type_error(absl::StrCat(
+            state.name, "(): incompatible function arguments; argument ", i,
+            " is not convertible to ", type_names[i + 1]));
+      }
+    }
+    if constexpr (std::is_void<R>::value) {
+      state.f(pybind11::detail::cast_op<Args>(std::move(std::get<Is>(casters)))...);
+      Py_RETURN_NONE;
+    } else {
+      return pybind11::detail::make_caster<R>::cast(
+                 state.f(pybind11::detail::cast_op<Args>(
+                     std::move(std::get<Is>(casters)))...),
+                 pybind11::return_value_policy::move, pybind11::handle())
+          .ptr();
+    }
+  }
+
+  static void Define(pybind11::module_& m, const char* name, F f,
+                     const char* doc) {
+    pybind11::capsule self(new State{std::move(f), name}, [](void* p) {
+      delete static_cast<State*>(p);
+    });
+    // Like pybind11, the method definition lives as long as the process.
+    auto* def = new PyMethodDef{
+        strdup(name),
+        reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(&Call)),
+        METH_FASTCALL, doc ? strdup(doc) : nullptr};
+    auto fn = pybind11::reinterpret_steal<pybind11::object>(
+        PyCFunction_NewEx(def, self.ptr(), m.attr("__name__").ptr()));
+    if (!fn) throw pybind11::error_already_set();
+    m.attr(name) = fn;
+  }
+};
+
+template <typename F, typename R, typename... Args>
+struct ProtoFn<F, R(Args...) const> : ProtoFn<F, R(Args...)> {};
+
+template <typename>
+struct ProtoFnSignature;
+
+template <typename U, typename T>
+struct ProtoFnSignature<U T::*> {
+  using type = U;
+};
+
+}  // namespace impl
+
+/// Defines name in module m as a direct CPython function calling f. f must be
+/// a function pointer or a functor with a single operator().
+template <typename F, typename S = typename impl::ProtoFnSignature<
+                          decltype(&F::operator())>::type>
+void def_proto_fn(pybind11::module_& m, const char* name, F f,
+                  const char* doc = nullptr) {
+  impl::ProtoFn<F, S>::Define(m, name, std::move(f), doc);
+}
+
+template <typename R, typename... Args>
+void def_proto_fn(pybind11::module_& m, const char* name, R (*f)(Args...),
+                  const char* doc = nullptr) {
+  impl::ProtoFn<R (*)(Args...), R(Args...)>::Define(m, name, f, doc);
+}
+
+}  // namespace pybind11_protobuf
+
+#endif  // PYBIND11_PROTOBUF_PROTO_FN_H_
@@ -0,0 +1,278 @@
+// IWYU pragma: always_keep // See pybind11/docs/type_caster_iwyu.rst
+
+#ifndef PYBIND11_PROTOBUF_PROTO_INPUT_STREAM_H_
+#define PYBIND11_PROTOBUF_PROTO_INPUT_STREAM_H_
+
+#include <pybind11/cast.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/pytypes.h>
+
+#include <Python.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "google/protobuf/message.h"
+#include "pybind11_protobuf/check_unknown_fields.h"
+#include "pybind11_protobuf/proto_cast_util.h"
+
+// ProtoInputStream<T> is a pull interface for consuming many protos in C++
+// batch by batch. A pybind11 type_caster<> converts any Python iterable of
+// messages to a ProtoInputStream<T>, so that bound C++ sinks do not need the
+// whole sequence materialized up front.
+//
+// The Python-backed stream takes the GIL once per batch to pull and
+// serialize the next messages on the calling thread, so the Python iterator
+// is only ever advanced by the thread consuming the stream. It then parses
+// them without the GIL, letting other Python threads run meanwhile, unless
+// unknown fields are checked (see check_unknown_fields), which consults the
+// Python descriptor pool. Functions taking a stream may release the GIL, e.g.
+// with pybind11::call_guard<pybind11::gil_scoped_release>.
+//
+// There is no prefetching: Next() pulls and parses its batch before
+// returning, so pulling does not overlap with the work of the consumer.
+//
+// Example:
+//
+// #include "pybind11_protobuf/proto_input_stream.h"
+//
+// void WriteAll(pybind11_protobuf::ProtoInputStream<MyMessage>& stream) {
+//   for (auto batch = stream.Next(); !batch.empty(); batch = stream.Next()) {
+//     for (const MyMessage* message : batch) writer.Write(*message);
+//   }
+// }
+//
+// PYBIND11_MODULE(my_module, m) {
+//   pybind11_protobuf::ImportNativeProtoCasters();
+//   m.def("write_all", &WriteAll,
+//         pybind11::call_guard<pybind11::gil_scoped_release>());
+// }
+//
+// my_module.write_all(message for message in source)
+
+namespace pybind11_protobuf {
+
+/// A stream of messages, consumed in batches.
+template <typename ProtoType>
+class ProtoInputStream {
+ public:
+  virtual ~ProtoInputStream() = default;
+
+  /// Returns the next batch of messages, which stays valid until the next
+  /// call. Returns an empty batch at the end of the stream.
+  virtual absl::Span<const ProtoType* const> Next() = 0;
+};
+
+/// ProtoInputStream over a Python iterator. Nothing is pulled from the
+/// iterator before the first call to Next(). Next() may be called with or
+/// without the GIL.
+template <typename ProtoType>
+class PythonProtoInputStream : public ProtoInputStream<ProtoType> {
+  static_assert(
+      std::is_base_of<::google::protobuf::Message, ProtoType>::value &&
+          !std::is_same<::google::protobuf::Message, ProtoType>::value,
+      "PythonProtoInputStream requires a generated message type");
+
+ public:
+  static constexpr size_t kDefaultBatchSize = 256;
+
+  // Requires the GIL.
+  explicit PythonProtoInputStream(pybind11::iterator iterator,
+                                  size_t batch_size = kDefaultBatchSize)
+      : iterator_(std::move(iterator)),
+        batch_size_(batch_size == 0 ? 1 : batch_size) {}
+
+  PythonProtoInputStream(const PythonProtoInputStream&) = delete;
+  PythonProtoInputStream& operator=(const PythonProtoInputStream&) = delete;
+
+  ~PythonProtoInputStream() override {
+    pybind11::gil_scoped_acquire gil;
+    stale_bytes_.clear();
+    iterator_ = pybind11::iterator();
+  }
+
+  absl::Span<const ProtoType* const> Next() override {
+    // The previous batch is no longer valid; release it before filling the
+    // next one.
+    current_.reset();
+    if (exhausted_) return {};
+    current_ = Fill();
+    return current_->pointers;
+  }
+
+ private:
+  struct Batch {
+    std::vector<ProtoType> messages;
+    std::vector<const ProtoType*> pointers;
+  };
+
+  template <typename F>
+  static void WithoutGil(F f) {
+    if (PyGILState_Check()) {
+      pybind11::gil_scoped_release release;
+      f();
+    } else {
+      f();
+    }
+  }
+
+  // Pulls the next batch from the iterator with a single GIL hold, and parses
+  // it without the GIL unless unknown fields are checked. Runs on the calling
+  // thread, with or without the GIL.
+  std::unique_ptr<Batch> Fill() {
+    auto batch = std::make_unique<Batch>();
+    batch->messages.reserve(batch_size_);
+    std::vector<pybind11::object> serialized;
+    serialized.reserve(batch_size_);
+    {
+      pybind11::gil_scoped_acquire gil;
+      // The bytes of the previous batch are released here, rather than with
+      // a separate GIL acquisition.
+      stale_bytes_.clear();
+      try {
+        while (batch->messages.size() < batch_size_) {
+          PyObject* next = PyIter_Next(iterator_.ptr());
+          if (next == nullptr) {
+            if (PyErr_Occurred()) throw pybind11::error_already_set();
+            exhausted_ = true;
+            break;
+          }
+          auto item = pybind11::reinterpret_steal<pybind11::object>(next);
+          batch->messages.emplace_back();
+          serialized.emplace_back(Serialize(item, &batch->messages.back()));
+        }
+      } catch (...) {
+        // Release the bytes while the GIL is still held.
+        serialized.clear();
+        exhausted_ = true;
+        throw;
+      }
+    }
+
+    bool parsed = true;
+    if (check_unknown_fields::ExtensionsWithUnknownFieldsPolicy::
+            UnknownFieldsAreChecked()) {
+      pybind11::gil_scoped_acquire gil;
+      try {
+        for (size_t i = 0; parsed && i < serialized.size(); ++i) {
+          if (!serialized[i]) continue;
+          parsed = ParsePartialFromPyBytesChecked(
+              pybind11::reinterpret_borrow<pybind11::bytes>(serialized[i]),
+              &batch->messages[i]);
+        }
+      } catch (...) {
+        serialized.clear();
+        exhausted_ = true;
+        throw;
+      }
+    } else {
+      WithoutGil([&] {
+        for (size_t i = 0; parsed && i < serialized.size(); ++i) {
+          if (!serialized[i]) continue;
+          // The bytes objects are immutable and referenced, so reading them
+          // without the GIL is safe.
+          PyObject* bytes = serialized[i].ptr();
+          parsed = batch->messages[i].ParsePartialFromArray(
+              PyBytes_AS_STRING(bytes),
+              static_cast<int>(PyBytes_GET_SIZE(bytes)));
+        }
+      });
+    }
+    stale_bytes_ = std::move(serialized);
+    if (!parsed) {
+      exhausted_ = true;
+      throw pybind11::value_error(
+          absl::StrCat("Failed to parse ", ProtoType::descriptor()->full_name(),
+                       " from the input stream"));
+    }
+
+    batch->pointers.reserve(batch->messages.size());
+    for (const auto& message : batch->messages) {
+      batch->pointers.push_back(&message);
+    }
+    return batch;
+  }
+
+  // Copies item into message when it is backed by the same C++ type;
+  // otherwise returns its serialization. Requires the GIL.
+  static pybind11::object Serialize(pybind11::handle item,
+                                    ProtoType* message) {
+    const ::google::protobuf::Message* cpp_message =
+        PyProtoGetCppMessagePointer(item);
+    if (cpp_message) {
+      const ProtoType* cpp_value =
+          ::google::protobuf::DynamicCastToGenerated<ProtoType>(cpp_message);
+      if (cpp_value) {
+        *message = *cpp_value;
+        return pybind11::object();
+      }
+    }
+    if (!PyProtoHasMatchingFullName(item, ProtoType::descriptor())) {
+      throw pybind11::type_error(
+          absl::StrCat("Expected an iterable of ",
+                       ProtoType::descriptor()->full_name(), ", got ",
+                       pybind11::repr(item).cast<std::string>()));
+    }
+    return PyProtoSerializePartialToString(item, /*raise_if_error=*/true);
+  }
+
+  pybind11::iterator iterator_;
+  const size_t batch_size_;
+
+  bool exhausted_ = false;
+  // The bytes of the current batch; only released with the GIL held.
+  std::vector<pybind11::object> stale_bytes_;
+
+  std::unique_ptr<Batch> current_;
+};
+
+// type_caster<> implementation for ProtoInputStream<T>.
+template <typename ProtoType>
+struct proto_input_stream_caster {
+  static constexpr auto name =
+      (pybind11::detail::const_name("Iterable[") +
+       pybind11::detail::const_name<ProtoType>() +
+       pybind11::detail::const_name("]"));
+
+  // load converts from Python -> C++. Nothing is consumed from src here, so
+  // that failed overloads do not lose messages.
+  bool load(pybind11::handle src, bool convert) {
+    if (!pybind11::isinstance<pybind11::iterable>(src) ||
+        pybind11::isinstance<pybind11::str>(src) ||
+        pybind11::isinstance<pybind11::bytes>(src) ||
+        PyProtoDescriptorFullName(src)) {
+      return false;
+    }
+    value = std::make_unique<PythonProtoInputStream<ProtoType>>(
+        pybind11::iter(src));
+    return true;
+  }
+
+  explicit operator ProtoInputStream<ProtoType>&() { return *value; }
+  explicit operator ProtoInputStream<ProtoType>*() { return value.get(); }
+
+  template <typename T_>
+  using cast_op_type = pybind11::detail::cast_op_type<T_>;
+
+  std::unique_ptr<PythonProtoInputStream<ProtoType>> value;
+};
+
+}  // namespace pybind11_protobuf
+
+namespace pybind11 {
+namespace detail {
+
+template <typename ProtoType>
+struct type_caster<pybind11_protobuf::ProtoInputStream<ProtoType>>
+    : public pybind11_protobuf::proto_input_stream_caster<ProtoType> {};
+
+}  // namespace detail
+}  // namespace pybind11
+
+#endif  // PYBIND11_PROTOBUF_PROTO_INPUT_STREAM_H_
@@ -0,0 +1,287 @@
+#ifndef PYBIND11_PROTOBUF_PROTO_ITERATOR_H_
+#define PYBIND11_PROTOBUF_PROTO_ITERATOR_H_
+
+#include <pybind11/pybind11.h>
+#include <pybind11/pytypes.h>
+
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
+#include "google/protobuf/message.h"
+#include "pybind11_protobuf/proto_cast_util.h"
+
+// Adapters which expose C++ producers of protos as Python iterators.
+//
+// A background thread runs the producer and serializes its messages in
+// chunks, while Python consumes the previous chunk. At most
+// ProtoIteratorOptions::max_chunks chunks are buffered, so memory stays
+// bounded however many messages are produced.
+//
+// Example:
+//
+// #include "pybind11_protobuf/proto_iterator.h"
+//
+// class Scanner {
+//  public:
+//   absl::optional<MyMessage> Next();
+// };
+//
+// PYBIND11_MODULE(my_module, m) {
+//   pybind11_protobuf::ImportNativeProtoCasters();
+//
+//   m.def("scan", [](std::string path) {
+//     auto scanner = std::make_shared<Scanner>(path);
+//     return pybind11_protobuf::MakeProtoIterator<MyMessage>(
+//         [scanner] { return scanner->Next(); });
+//   });
+// }
+//
+// for message in my_module.scan(path):
+//   ...
+
+namespace pybind11_protobuf {
+
+struct ProtoIteratorOptions {
+  // Number of messages serialized per chunk.
+  size_t chunk_size = 64;
+
+  // Number of chunks buffered ahead of the Python consumer.
+  size_t max_chunks = 2;
+};
+
+namespace impl {
+
+// Shared state of a Python iterator and its producer thread.
+class ProtoStreamState {
+ public:
+  struct Chunk {
+    std::vector<const ::google::protobuf::Descriptor*> descriptors;
+    std::vector<std::string> items;
+  };
+
+  // Passed to the producer, which calls Push for every message.
+  class Sink {
+   public:
+    // Serializes message into the pending chunk. Returns false once the
+    // Python iterator has been destroyed, in which case the producer should
+    // return.
+    bool Push(const ::google::protobuf::Message& message) {
+      chunk_.descriptors.push_back(message.GetDescriptor());
+      chunk_.items.push_back(message.SerializePartialAsString());
+      if (chunk_.items.size() < state_->options_.chunk_size) {
+        return !state_->Cancelled();
+      }
+      return Flush();
+    }
+
+   private:
+    friend class ProtoStreamState;
+    explicit Sink(ProtoStreamState* state) : state_(state) {}
+
+    bool Flush() {
+      if (chunk_.items.empty()) return !state_->Cancelled();
+      bool published = state_->Publish(std::move(chunk_));
+      chunk_ = Chunk();
+      return published;
+    }
+
+    ProtoStreamState* state_;
+    Chunk chunk_;
+  };
+
+  ProtoStreamState(std::function<void(Sink&)> produce,
+                   ProtoIteratorOptions options)
+      : options_(options) {
+    if (options_.chunk_size == 0) options_.chunk_size = 1;
+    if (options_.max_chunks == 0) options_.max_chunks = 1;
+    producer_ = std::thread([this, produce = std::move(produce)]() {
+      Sink sink(this);
+      std::string error;
+      try {
+        produce(sink);
+      } catch (const std::exception& e) {
+        error = e.what();
+      }
+      // Messages pushed before an error are still delivered.
+      sink.Flush();
+      absl::MutexLock lock(&mutex_);
+      finished_ = true;
+      error_ = std::move(error);
+    });
+  }
+
+  ProtoStreamState(const ProtoStreamState&) = delete;
+  ProtoStreamState& operator=(const ProtoStreamState&) = delete;
+
+  // Stops and joins the producer. The producer does not need the GIL, so
+  // this is safe while holding it, but it waits for a pending call into the
+  // producer to return.
+  ~ProtoStreamState() {
+    {
+      absl::MutexLock lock(&mutex_);
+      cancelled_ = true;
+    }
+    producer_.join();
+  }
+
+  // Returns true when all messages have been consumed, or the producer's
+  // error has been raised; from then on, the stream stays done. Waits for
+  // the producer with the GIL released. Requires the GIL.
+  bool Done() {
+    if (terminated_) return true;
+    if (index_ < current_.items.size()) return false;
+    {
+      pybind11::gil_scoped_release release;
+      absl::MutexLock lock(&mutex_);
+      mutex_.Await(absl::Condition(
+          +[](ProtoStreamState* state) {
+            state->mutex_.AssertHeld();
+            return !state->queue_.empty() || state->finished_;
+          },
+          this));
+      if (!queue_.empty()) {
+        current_ = std::move(queue_.front());
+        queue_.pop_front();
+        index_ = 0;
+        return false;
+      }
+    }
+    terminated_ = true;
+    if (!error_.empty()) {
+      std::string error = std::move(error_);
+      error_.clear();
+      throw std::runtime_error(error);
+    }
+    return true;
+  }
+
+  // Returns the current message. Requires the GIL, and !Done().
+  pybind11::object Current() {
+    return PyProtoFromSerializedString(current_.descriptors[index_],
+                                       current_.items[index_]);
+  }
+
+  // Moves past the current message. A no-op once the stream is done, since
+  // pybind11 advances the iterator again on the next call after an error.
+  void Advance() {
+    if (terminated_ || index_ >= current_.items.size()) return;
+    // Release the serialized message early.
+    std::string().swap(current_.items[index_]);
+    ++index_;
+  }
+
+ private:
+  bool Cancelled() {
+    absl::MutexLock lock(&mutex_);
+    return cancelled_;
+  }
+
+  // Waits for room in the queue, and appends chunk. Returns false if
+  // cancelled.
+  bool Publish(Chunk chunk) {
+    absl::MutexLock lock(&mutex_);
+    mutex_.Await(absl::Condition(
+        +[](ProtoStreamState* state) {
+          state->mutex_.AssertHeld();
+          return state->cancelled_ ||
+                 state->queue_.size() < state->options_.max_chunks;
+        },
+        this));
+    if (cancelled_) return false;
+    queue_.push_back(std::move(chunk));
+    return true;
+  }
+
+  ProtoIteratorOptions options_;
+
+  absl::Mutex mutex_;
+  std::deque<Chunk> queue_ ABSL_GUARDED_BY(mutex_);
+  bool finished_ ABSL_GUARDED_BY(mutex_) = false;
+  bool cancelled_ ABSL_GUARDED_BY(mutex_) = false;
+  // Only read by the consumer once finished_ is set.
+  std::string error_;
+
+  // Only accessed by the consumer, with the GIL held.
+  Chunk current_;
+  size_t index_ = 0;
+  bool terminated_ = false;
+
+  std::thread producer_;
+};
+
+// Iterator and sentinel over a ProtoStreamState, for pybind11::make_iterator.
+struct ProtoStreamSentinel {};
+
+struct ProtoStreamIterator {
+  std::shared_ptr<ProtoStreamState> state;
+
+  pybind11::object operator*() const { return state->Current(); }
+  ProtoStreamIterator& operator++() {
+    state->Advance();
+    return *this;
+  }
+  bool operator==(const ProtoStreamSentinel&) const { return state->Done(); }
+  bool operator!=(const ProtoStreamSentinel& end) const {
+    return !(*this == end);
+  }
+};
+
+}  // namespace impl
+
+using ProtoSink = impl::ProtoStreamState::Sink;
+
+/// Returns a Python iterator over the messages passed to the sink by produce,
+/// which runs on a background thread without the GIL. produce should return
+/// when ProtoSink::Push returns false. Exceptions thrown by produce are
+/// raised as RuntimeError once the preceding messages have been consumed.
+inline pybind11::iterator MakeProtoIteratorFromCallback(
+    std::function<void(ProtoSink&)> produce,
+    ProtoIteratorOptions options = {}) {
+  auto state =
+      std::make_shared<impl::ProtoStreamState>(std::move(produce), options);
+  return pybind11::make_iterator<pybind11::return_value_policy::move>(
+      impl::ProtoStreamIterator{std::move(state)}, impl::ProtoStreamSentinel{});
+}
+
+/// Returns a Python iterator over the messages returned by next, which is
+/// called on a background thread until it returns absl::nullopt.
+template <typename ProtoType>
+pybind11::iterator MakeProtoIterator(
+    std::function<absl::optional<ProtoType>()> next,
+    ProtoIteratorOptions options = {}) {
+  return MakeProtoIteratorFromCallback(
+      [next = std::move(next)](ProtoSink& sink) {
+        while (absl::optional<ProtoType> message = next()) {
+          if (!sink.Push(*message)) return;
+        }
+      },
+      options);
+}
+
+/// Returns a Python iterator over [begin, end). The range must outlive the
+/// iterator; use pybind11::keep_alive<> when it is owned by a bound object.
+template <typename Iterator, typename Sentinel>
+pybind11::iterator MakeProtoIterator(Iterator begin, Sentinel end,
+                                     ProtoIteratorOptions options = {}) {
+  return MakeProtoIteratorFromCallback(
+      [begin, end](ProtoSink& sink) mutable {
+        for (; begin != end; ++begin) {
+          if (!sink.Push(*begin)) return;
+        }
+      },
+      options);
+}
+
+}  // namespace pybind11_protobuf
+
+#endif  // PYBIND11_PROTOBUF_PROTO_ITERATOR_H_
@@ -0,0 +1,193 @@
+#ifndef PYBIND11_PROTOBUF_PROTO_OVERLOADS_H_
+#define PYBIND11_PROTOBUF_PROTO_OVERLOADS_H_
+
+#include <pybind11/pybind11.h>
+#include <pybind11/pytypes.h>
+
+#include <Python.h>
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/types/optional.h"
+#include "google/protobuf/message.h"
+#include "pybind11_protobuf/proto_cast_util.h"
+
+// ProtoOverloads dispatches a Python message to one of several C++ functions
+// according to its type. Overloading a binding on many message types makes
+// pybind11 try each overload in turn, checking the descriptor full name every
+// time; ProtoOverloads looks up the Python class of the argument in a hash
+// table instead, falling back to its descriptor full name the first time a
+// class is seen.
+//
+// ProtoOverloads also converts the message only once per call. pybind11 loads
+// the arguments again for each overload it tries, first without and then with
+// implicit conversions, and destroys the casters between attempts: a caster
+// cannot tell two attempts of the same call apart from two calls, so it cannot
+// reuse an earlier conversion. ProtoOverloads selects the function from the
+// Python class before converting, and converts for that function alone.
+//
+// Example:
+//
+// #include "pybind11_protobuf/proto_overloads.h"
+//
+// PYBIND11_MODULE(my_module, m) {
+//   pybind11_protobuf::ImportNativeProtoCasters();
+//
+//   m.def("handle", pybind11_protobuf::ProtoOverloads<Response>()
+//                       .Add<CreateRequest>(&HandleCreate)
+//                       .Add<DeleteRequest>(&HandleDelete));
+//
+//   // Or, for a function taking a std::variant of messages:
+//   m.def("handle_variant",
+//         pybind11_protobuf::DispatchProtoVariant<
+//             std::variant<CreateRequest, DeleteRequest>>(&Handle));
+// }
+
+namespace pybind11_protobuf {
+
+/// A function object taking a Python message, and further arguments Args,
+/// which calls the function added for the type of the message. Requires the
+/// GIL.
+template <typename R, typename... Args>
+class ProtoOverloads {
+ public:
+  ProtoOverloads() : state_(std::make_shared<State>()) {}
+
+  /// Adds f, callable with (const ProtoType&, Args...), for messages of type
+  /// ProtoType. Later additions for the same type replace earlier ones. If f
+  /// is also callable with (ProtoType&&, Args...), a message parsed from a
+  /// Python message is moved into it.
+  template <typename ProtoType, typename F>
+  ProtoOverloads& Add(F f) {
+    static_assert(
+        std::is_base_of<::google::protobuf::Message, ProtoType>::value &&
+            !std::is_same<::google::protobuf::Message, ProtoType>::value,
+        "ProtoOverloads requires generated message types");
+    const std::string& full_name = ProtoType::GetDescriptor()->full_name();
+    auto [it, inserted] =
+        state_->by_full_name.try_emplace(full_name, state_->entries.size());
+    Entry entry = [f = std::move(f)](pybind11::handle message,
+                                     Args... args) mutable -> R {
+      std::unique_ptr<ProtoType> owned;
+      const ProtoType& loaded = Load<ProtoType>(message, &owned);
+      if constexpr (std::is_invocable_v<F&, ProtoType&&, Args...>) {
+        if (owned) return f(std::move(*owned), std::forward<Args>(args)...);
+      }
+      return f(loaded, std::forward<Args>(args)...);
+    };
+    if (inserted) {
+      state_->entries.push_back(std::move(entry));
+      state_->names.push_back(full_name);
+    } else {
+      state_->entries[it->second] = std::move(entry);
+    }
+    state_->by_type.clear();
+    return *this;
+  }
+
+  R operator()(pybind11::handle message, Args... args) const {
+    return state_->entries[Find(message)](message,
+                                          std::forward<Args>(args)...);
+  }
+
+ private:
+  using Entry = std::function<R(pybind11::handle, Args...)>;
+
+  struct State {
+    std::vector<Entry> entries;
+    std::vector<std::string> names;
+    absl::flat_hash_map<std::string, size_t> by_full_name;
+    // Keeps a reference to each class, so that its address is not reused.
+    absl::flat_hash_map<PyTypeObject*, std::pair<pybind11::object, size_t>>
+        by_type;
+  };
+
+  size_t Find(pybind11::handle message) const {
+    PyTypeObject* type = Py_TYPE(message.ptr());
+    auto cached = state_->by_type.find(type);
+    if (cached != state_->by_type.end()) return cached->second.second;
+
+    absl::optional<std::string> full_name = PyProtoDescriptorFullName(message);
+    auto found = full_name ? state_->by_full_name.find(*full_name)
+                           : state_->by_full_name.end();
+    if (found == state_->by_full_name.end()) {
+      throw pybind11::type_error(absl::StrCat(
+          "Expected one of ", absl::StrJoin(state_->names, ", "), ", got ",
+          pybind11::repr(message).cast<std::string>()));
+    }
+    state_->by_type.try_emplace(
+        type,
+        pybind11::reinterpret_borrow<pybind11::object>(
+            reinterpret_cast<PyObject*>(type)),
+        found->second);
+    return found->second;
+  }
+
+  // Converts a message whose full name is known to match ProtoType. Sets
+  // *owned if the message had to be parsed.
+  template <typename ProtoType>
+  static const ProtoType& Load(pybind11::handle message,
+                               std::unique_ptr<ProtoType>* owned) {
+    const ::google::protobuf::Message* cpp_message =
+        PyProtoGetCppMessagePointer(message);
+    if (cpp_message) {
+      const ProtoType* value =
+          ::google::protobuf::DynamicCastToGenerated<ProtoType>(cpp_message);
+      if (value) return *value;
+    }
+    pybind11::bytes serialized =
+        PyProtoSerializePartialToString(message, /*raise_if_error=*/true);
+    *owned = std::make_unique<ProtoType>();
+    if (!serialized ||
+        !ParsePartialFromPyBytesChecked(std::move(serialized), owned->get())) {
+      throw pybind11::type_error(
+          absl::StrCat("Failed to convert ",
+                       pybind11::repr(message).cast<std::string>(), " to ",
+                       ProtoType::GetDescriptor()->full_name()));
+    }
+    return **owned;
+  }
+
+  std::shared_ptr<State> state_;
+};
+
+namespace impl {
+
+template <typename R, typename Variant, typename F, typename... Protos>
+ProtoOverloads<R> MakeProtoVariantOverloads(F f, std::variant<Protos...>*) {
+  auto shared_f = std::make_shared<F>(std::move(f));
+  ProtoOverloads<R> overloads;
+  // Parsed messages are moved into the variant; only messages backed by C++
+  // are copied.
+  (overloads.template Add<Protos>([shared_f](auto&& message) -> R {
+    return (*shared_f)(Variant(std::in_place_type<Protos>,
+                               std::forward<decltype(message)>(message)));
+  }),
+   ...);
+  return overloads;
+}
+
+}  // namespace impl
+
+/// Returns ProtoOverloads calling f, which takes a Variant of messages, with
+/// the alternative matching the type of the Python message.
+template <typename Variant, typename F>
+auto DispatchProtoVariant(F f) {
+  using R = std::invoke_result_t<F&, Variant>;
+  return impl::MakeProtoVariantOverloads<R, Variant>(
+      std::move(f), static_cast<Variant*>(nullptr));
+}
+
+}  // namespace pybind11_protobuf
+
+#endif  // PYBIND11_PROTOBUF_PROTO_OVERLOADS_H_
@@ -0,0 +1,280 @@
+#ifndef PYBIND11_PROTOBUF_PROTO_QUEUE_H_
+#define PYBIND11_PROTOBUF_PROTO_QUEUE_H_
+
+#include <pybind11/pybind11.h>
+#include <pybind11/pytypes.h>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "google/protobuf/message.h"
+#include "pybind11_protobuf/proto_cast_util.h"
+
+// ProtoQueue hands messages from C++ threads to Python in batches.
+//
+// Producers push messages, or buffers they have already serialized, without
+// the GIL and without taking a lock. Python drains the queue with a single
+// call, which builds a list of Python messages under one GIL hold. The
+// queue is bounded: TryPush fails and Push blocks while it is full.
+//
+// Example:
+//
+// #include "pybind11_protobuf/proto_queue.h"
+//
+// PYBIND11_MODULE(my_module, m) {
+//   pybind11_protobuf::ImportNativeProtoCasters();
+//   pybind11_protobuf::DefineProtoQueue(m);
+//
+//   m.def("start_workers",
+//         [](std::shared_ptr<pybind11_protobuf::ProtoQueue> queue) {
+//           StartWorkers([queue](const MyEvent& event) { queue->Push(event); });
+//         });
+// }
+//
+// queue = my_module.ProtoQueue(capacity=10000)
+// my_module.start_workers(queue)
+// while True:
+//   for event in queue.drain(max_items=1000, timeout=1.0):
+//     ...
+
+namespace pybind11_protobuf {
+
+class ProtoQueue {
+ public:
+  explicit ProtoQueue(size_t capacity) : capacity_(capacity ? capacity : 1) {}
+
+  ProtoQueue(const ProtoQueue&) = delete;
+  ProtoQueue& operator=(const ProtoQueue&) = delete;
+
+  ~ProtoQueue() {
+    Node* node = head_.load(std::memory_order_acquire);
+    while (node != nullptr) {
+      Node* next = node->next;
+      delete node;
+      node = next;
+    }
+    absl::MutexLock lock(&consumer_mutex_);
+    for (Node* pending : pending_) delete pending;
+  }
+
+  size_t capacity() const { return capacity_; }
+
+  // Number of queued messages, including ones which are being drained.
+  size_t size() const { return size_.load(std::memory_order_relaxed); }
+
+  bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+  /// Enqueues a copy of message. Returns false if the queue is full or
+  /// closed. Lock-free, and does not need the GIL.
+  bool TryPush(const ::google::protobuf::Message& message) {
+    if (!Reserve()) return false;
+    Link(new Node{nullptr, message.GetDescriptor(),
+                  message.SerializePartialAsString()});
+    return true;
+  }
+
+  /// Enqueues a message of the given type, already serialized.
+  bool TryPushSerialized(const ::google::protobuf::Descriptor* descriptor,
+                         std::string serialized) {
+    if (!Reserve()) return false;
+    Link(new Node{nullptr, descriptor, std::move(serialized)});
+    return true;
+  }
+
+  /// Like TryPush, but waits while the queue is full. Returns false if the
+  /// queue is closed.
+  bool Push(const ::google::protobuf::Message& message) {
+    while (!TryPush(message)) {
+      if (!WaitForRoom()) return false;
+    }
+    return true;
+  }
+
+  bool PushSerialized(const ::google::protobuf::Descriptor* descriptor,
+                      std::string serialized) {
+    while (!Reserve()) {
+      if (!WaitForRoom()) return false;
+    }
+    Link(new Node{nullptr, descriptor, std::move(serialized)});
+    return true;
+  }
+
+  /// Rejects further pushes, and wakes up waiting producers and consumers.
+  void Close() {
+    closed_.store(true, std::memory_order_release);
+    absl::MutexLock lock(&wait_mutex_);
+    wait_cv_.SignalAll();
+  }
+
+  /// Returns up to max_items (0 for no limit) messages as a list of Python
+  /// messages, oldest first. Waits until deadline while the queue is empty
+  /// and open, with the GIL released. Requires the GIL.
+  pybind11::list Drain(size_t max_items, absl::Time deadline) {
+    std::vector<std::unique_ptr<Node>> batch;
+    {
+      pybind11::gil_scoped_release release;
+      Take(max_items, deadline, &batch);
+    }
+
+    pybind11::list result(batch.size());
+    absl::flat_hash_map<const ::google::protobuf::Descriptor*, pybind11::object>
+        classes;
+    for (size_t i = 0; i < batch.size(); ++i) {
+      const Node& node = *batch[i];
+      pybind11::object& message_class = classes[node.descriptor];
+      if (!message_class) {
+        message_class = PyProtoMessageClass(node.descriptor);
+      }
+      PyList_SET_ITEM(result.ptr(), i,
+                      PyProtoFromSerializedString(message_class,
+                                                  node.descriptor,
+                                                  node.serialized)
+                          .release()
+                          .ptr());  // steals a reference
+    }
+    return result;
+  }
+
+ private:
+  struct Node {
+    Node* next;
+    const ::google::protobuf::Descriptor* descriptor;
+    std::string serialized;
+  };
+
+  bool Reserve() {
+    if (closed()) return false;
+    if (size_.fetch_add(1) >= capacity_) {
+      size_.fetch_sub(1);
+      return false;
+    }
+    return true;
+  }
+
+  // Pushes node onto the stack, and wakes up a waiting consumer.
+  void Link(Node* node) {
+    node->next = head_.load(std::memory_order_relaxed);
+    while (!head_.compare_exchange_weak(node->next, node)) {
+    }
+    if (waiters_.load() > 0) {
+      absl::MutexLock lock(&wait_mutex_);
+      wait_cv_.SignalAll();
+    }
+  }
+
+  // Waits until the queue has room or is closed. Returns false if closed.
+  bool WaitForRoom() {
+    waiters_.fetch_add(1);
+    {
+      absl::MutexLock lock(&wait_mutex_);
+      while (size_.load() >= capacity_ && !closed()) {
+        wait_cv_.Wait(&wait_mutex_);
+      }
+    }
+    waiters_.fetch_sub(1);
+    return !closed();
+  }
+
+  // Moves up to max_items of the oldest nodes to batch.
+  void Take(size_t max_items, absl::Time deadline,
+            std::vector<std::unique_ptr<Node>>* batch) {
+    absl::MutexLock consumer_lock(&consumer_mutex_);
+    if (pending_.empty()) {
+      TakeAllLocked();
+    }
+    if (pending_.empty() && !closed() && deadline > absl::Now()) {
+      waiters_.fetch_add(1);
+      {
+        absl::MutexLock lock(&wait_mutex_);
+        while (head_.load() == nullptr && !closed()) {
+          if (wait_cv_.WaitWithDeadline(&wait_mutex_, deadline)) break;
+        }
+      }
+      waiters_.fetch_sub(1);
+      TakeAllLocked();
+    }
+
+    size_t n = pending_.size();
+    if (max_items != 0 && max_items < n) n = max_items;
+    batch->reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+      batch->emplace_back(pending_.back());
+      pending_.pop_back();
+    }
+    if (n != 0) {
+      size_.fetch_sub(n);
+      if (waiters_.load() > 0) {
+        absl::MutexLock lock(&wait_mutex_);
+        wait_cv_.SignalAll();
+      }
+    }
+  }
+
+  // Moves the stack to pending_, which is kept newest first, so that the
+  // oldest node is at the back.
+  void TakeAllLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(consumer_mutex_) {
+    Node* node = head_.exchange(nullptr);
+    std::vector<Node*> taken;
+    for (; node != nullptr; node = node->next) {
+      taken.push_back(node);
+    }
+    // taken is newest first; anything already in pending_ is older.
+    pending_.insert(pending_.begin(), taken.begin(), taken.end());
+  }
+
+  const size_t capacity_;
+  std::atomic<size_t> size_{0};
+  std::atomic<bool> closed_{false};
+
+  // Treiber stack of pushed nodes, newest first.
+  std::atomic<Node*> head_{nullptr};
+
+  // Nodes taken off the stack but not drained yet. Only one thread drains at
+  // a time.
+  absl::Mutex consumer_mutex_;
+  std::vector<Node*> pending_ ABSL_GUARDED_BY(consumer_mutex_);
+
+  // Only used to block; pushes and drains do not take it unless someone is
+  // waiting.
+  std::atomic<int> waiters_{0};
+  absl::Mutex wait_mutex_;
+  absl::CondVar wait_cv_;
+};
+
+/// Binds ProtoQueue as a Python class, held by std::shared_ptr so that C++
+/// producers can share it.
+inline void DefineProtoQueue(pybind11::module_& m,
+                             const char* name = "ProtoQueue") {
+  pybind11::class_<ProtoQueue, std::shared_ptr<ProtoQueue>>(m, name)
+      .def(pybind11::init<size_t>(), pybind11::arg("capacity"))
+      .def_property_readonly("capacity", &ProtoQueue::capacity)
+      .def_property_readonly("closed", &ProtoQueue::closed)
+      .def("__len__", &ProtoQueue::size)
+      .def("close", &ProtoQueue::Close)
+      .def(
+          "drain",
+          [](ProtoQueue& queue, size_t max_items, pybind11::object timeout) {
+            absl::Time deadline =
+                timeout.is_none()
+                    ? absl::InfiniteFuture()
+                    : absl::Now() + absl::Seconds(timeout.cast<double>());
+            return queue.Drain(max_items, deadline);
+          },
+          pybind11::arg("max_items") = 0,
+          pybind11::arg("timeout") = pybind11::none(),
+          "Returns up to max_items (0 for all) queued messages, oldest first. "
+          "Waits up to timeout seconds (None: indefinitely) while the queue "
+          "is empty and open.");
+}
+
+}  // namespace pybind11_protobuf
+
+#endif  // PYBIND11_PROTOBUF_PROTO_QUEUE_H_
@@ -0,0 +1,214 @@
+#ifndef PYBIND11_PROTOBUF_RETURN_FIELDS_H_
+#define PYBIND11_PROTOBUF_RETURN_FIELDS_H_
+
+#include <pybind11/pybind11.h>
+#include <pybind11/pytypes.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/message.h"
+#include "google/protobuf/wire_format.h"
+#include "google/protobuf/wire_format_lite.h"
+#include "pybind11_protobuf/proto_cast_util.h"
+
+// WithReturnFields wraps a function returning a large message, of which the
+// Python caller uses only a few fields. Only the listed field paths are
+// serialized and parsed into the Python message; the rest never cross the
+// boundary.
+//
+// A path names a field, or a field of a message field, such as
+// "stats.count". Paths through repeated message fields apply to every
+// element. Proto2 groups are supported like message fields. Paths are checked
+// against the descriptor when the binding is defined.
+//
+// Example:
+//
+// #include "pybind11_protobuf/return_fields.h"
+//
+// PYBIND11_MODULE(my_module, m) {
+//   pybind11_protobuf::ImportNativeProtoCasters();
+//
+//   m.def("analyze", pybind11_protobuf::WithReturnFields(
+//                        &Analyze, {"summary", "scores"}));
+// }
+
+namespace pybind11_protobuf {
+namespace impl {
+
+// A tree of fields to keep. A field without children is kept whole.
+struct ProtoFieldProjection {
+  // Ordered by field number, as the fields are serialized.
+  std::vector<
+      std::pair<const ::google::protobuf::FieldDescriptor*,
+                std::unique_ptr<ProtoFieldProjection>>>
+      fields;
+
+  // Throws std::invalid_argument if a path does not name a field.
+  static std::unique_ptr<ProtoFieldProjection> Create(
+      const ::google::protobuf::Descriptor* descriptor,
+      const std::vector<std::string>& paths) {
+    auto root = std::make_unique<ProtoFieldProjection>();
+    for (const std::string& path : paths) {
+      ProtoFieldProjection* node = root.get();
+      const ::google::protobuf::Descriptor* type = descriptor;
+      std::vector<absl::string_view> names = absl::StrSplit(path, '.');
+      for (size_t i = 0; i < names.size(); ++i) {
+        const ::google::protobuf::FieldDescriptor* field =
+            type ? type->FindFieldByName(std::string(names[i])) : nullptr;
+        if (field == nullptr || (i + 1 < names.size() && field->is_map())) {
+          throw std::invalid_argument(
+              absl::StrCat("Invalid field path \"", path, "\" for ",
+                           descriptor->full_name()));
+        }
+        node = node->Child(field, /*whole=*/i + 1 == names.size());
+        if (node == nullptr) break;  // The field is already kept whole.
+        type = field->message_type();
+      }
+    }
+    return root;
+  }
+
+  // Appends the fields of message selected by this projection to out. The
+  // sizes of message must have been cached by ByteSizeLong().
+  void Serialize(const ::google::protobuf::Message& message,
+                 std::string* out) const {
+    const auto* reflection = message.GetReflection();
+    ::google::protobuf::io::StringOutputStream stream(out);
+    ::google::protobuf::io::CodedOutputStream coded(&stream);
+    coded.SetSerializationDeterministic(true);
+    std::string nested;
+    for (const auto& [field, child] : fields) {
+      if (!child) {
+        ::google::protobuf::internal::WireFormat::
+            SerializeFieldWithCachedSizes(field, message, &coded);
+        continue;
+      }
+      auto write = [&](const ::google::protobuf::Message& sub) {
+        using ::google::protobuf::internal::WireFormatLite;
+        nested.clear();
+        child->Serialize(sub, &nested);
+        if (field->type() == ::google::protobuf::FieldDescriptor::TYPE_GROUP) {
+          // Groups are delimited by tags rather than by their length.
+          coded.WriteTag(WireFormatLite::MakeTag(
+              field->number(), WireFormatLite::WIRETYPE_START_GROUP));
+          coded.WriteString(nested);
+          coded.WriteTag(WireFormatLite::MakeTag(
+              field->number(), WireFormatLite::WIRETYPE_END_GROUP));
+          return;
+        }
+        coded.WriteTag(WireFormatLite::MakeTag(
+            field->number(), WireFormatLite::WIRETYPE_LENGTH_DELIMITED));
+        coded.WriteVarint32(static_cast<uint32_t>(nested.size()));
+        coded.WriteString(nested);
+      };
+      if (field->is_repeated()) {
+        int size = reflection->FieldSize(message, field);
+        for (int i = 0; i < size; ++i) {
+          write(reflection->GetRepeatedMessage(message, field, i));
+        }
+      } else if (reflection->HasField(message, field)) {
+        write(reflection->GetMessage(message, field));
+      }
+    }
+  }
+
+ private:
+  // Returns the node for field, or nullptr if it is kept whole.
+  ProtoFieldProjection* Child(const ::google::protobuf::FieldDescriptor* field,
+                              bool whole) {
+    auto it = fields.begin();
+    while (it != fields.end() && it->first->number() < field->number()) ++it;
+    if (it == fields.end() || it->first != field) {
+      it = fields.emplace(
+          it, field,
+          whole ? nullptr : std::make_unique<ProtoFieldProjection>());
+    } else if (whole) {
+      it->second.reset();
+    }
+    return it->second.get();
+  }
+};
+
+template <typename F, typename Signature>
+struct ReturnFields;
+
+template <typename F, typename R, typename... Args>
+struct ReturnFields<F, R(Args...)> {
+  using ProtoType = std::remove_cv_t<std::remove_reference_t<R>>;
+  static_assert(
+      std::is_base_of<::google::protobuf::Message, ProtoType>::value &&
+          !std::is_same<::google::protobuf::Message, ProtoType>::value,
+      "WithReturnFields requires a function returning a generated message "
+      "by value or reference");
+
+  struct State {
+    F f;
+    std::unique_ptr<ProtoFieldProjection> projection;
+  };
+
+  static auto Wrap(F f, const std::vector<std::string>& paths) {
+    auto state = std::make_shared<State>(
+        State{std::move(f), ProtoFieldProjection::Create(
+                                ProtoType::GetDescriptor(), paths)});
+    return [state](Args... args) -> pybind11::object {
+      return Project(*state, state->f(std::forward<Args>(args)...));
+    };
+  }
+
+  static pybind11::object Project(const State& state,
+                                  const ProtoType& message) {
+    // Only caches sizes, which the serialized fields need.
+    message.ByteSizeLong();
+    std::string serialized;
+    state.projection->Serialize(message, &serialized);
+    // The binding may have released the GIL for the call.
+    pybind11::gil_scoped_acquire gil;
+    return PyProtoFromSerializedString(ProtoType::GetDescriptor(),
+                                       serialized);
+  }
+};
+
+template <typename F, typename R, typename... Args>
+struct ReturnFields<F, R(Args...) const> : ReturnFields<F, R(Args...)> {};
+
+template <typename>
+struct ReturnFieldsSignature;
+
+template <typename U, typename T>
+struct ReturnFieldsSignature<U T::*> {
+  using type = U;
+};
+
+}  // namespace impl
+
+/// Returns a function calling f, whose result is converted to a Python
+/// message holding only the fields named by paths. f must be a function
+/// pointer or a functor with a single operator(). Throws
+/// std::invalid_argument if a path does not name a field.
+template <typename F, typename S = typename impl::ReturnFieldsSignature<
+                          decltype(&F::operator())>::type>
+auto WithReturnFields(F f, const std::vector<std::string>& paths) {
+  return impl::ReturnFields<F, S>::Wrap(std::move(f), paths);
+}
+
+template <typename R, typename... Args>
+auto WithReturnFields(R (*f)(Args...), const std::vector<std::string>& paths) {
+  return impl::ReturnFields<R (*)(Args...), R(Args...)>::Wrap(f, paths);
+}
+
+}  // namespace pybind11_protobuf
+
+#endif  // PYBIND11_PROTOBUF_RETURN_FIELDS_H_
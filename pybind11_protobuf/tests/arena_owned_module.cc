@@ -0,0 +1,61 @@
+// Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+//
+// All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include <pybind11/pybind11.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "google/protobuf/arena.h"
+#include "pybind11_protobuf/arena_owned.h"
+#include "pybind11_protobuf/native_proto_caster.h"
+#include "pybind11_protobuf/tests/test.pb.h"
+
+namespace py = ::pybind11;
+
+namespace {
+
+using ::google::protobuf::Arena;
+using ::pybind11::test::TestMessage;
+using ::pybind11_protobuf::ArenaOwned;
+
+int arenas_destroyed = 0;
+
+PYBIND11_MODULE(arena_owned_module, m) {
+  // FrozenMessage is defined on first use, without DefineFrozenProtos.
+  pybind11_protobuf::ImportNativeProtoCasters();
+
+  m.def("build", [](int value) {
+    std::shared_ptr<Arena> arena(new Arena(), [](Arena* arena) {
+      ++arenas_destroyed;
+      delete arena;
+    });
+    auto* message = Arena::Create<TestMessage>(arena.get());
+    message->set_int_value(value);
+    message->set_string_value(std::string(value, 'x'));
+    message->mutable_int_message()->set_value(value + 1);
+    for (int i = 0; i < value; ++i) {
+      message->add_repeated_int_message()->set_value(i);
+    }
+    (*message->mutable_string_int_map())["v"] = value;
+    message->set_enum_value(TestMessage::TWO);
+    return ArenaOwned<TestMessage>(std::move(arena), message);
+  });
+
+  m.def("build_none", []() { return ArenaOwned<TestMessage>(); });
+
+  m.def("arenas_destroyed", []() { return arenas_destroyed; });
+
+  m.def("int_value",
+        [](const TestMessage& message) { return message.int_value(); });
+
+  // Returns whether message is allocated on an arena, i.e. was not copied.
+  m.def("on_arena", [](const TestMessage& message) {
+    return message.GetArena() != nullptr;
+  });
+}
+
+}  // namespace
@@ -0,0 +1,71 @@
+# Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+#
+# All rights reserved. Use of this source code is governed by a
+# BSD-style license that can be found in the LICENSE file.
+"""Tests for ArenaOwned<T> results."""
+
+import gc
+
+from absl.testing import absltest
+
+from pybind11_protobuf.tests import arena_owned_module as m
+from pybind11_protobuf.tests import test_pb2
+
+
+class ArenaOwnedTest(absltest.TestCase):
+
+  def test_result(self):
+    result = m.build(3)
+    self.assertEqual('FrozenMessage', type(result).__name__)
+    self.assertEqual('pybind11.test.TestMessage', result.DESCRIPTOR.full_name)
+    self.assertEqual(3, result.message.int_value)
+    self.assertEqual('xxx', result.message.string_value)
+    self.assertIs(result.message, result.message)
+
+  def test_fields(self):
+    result = m.build(3)
+    self.assertEqual(3, result.int_value)
+    self.assertEqual('xxx', result.string_value)
+    self.assertEqual(0.0, result.double_value)
+    self.assertEqual(test_pb2.TestMessage.TWO, result.enum_value)
+    self.assertEqual(4, result.int_message.value)
+    self.assertEqual([0, 1, 2],
+                     [x.value for x in result.repeated_int_message])
+    self.assertEqual({'v': 3}, result.string_int_map)
+    self.assertEqual([], result.repeated_int_value)
+    # Other attributes are those of the Python message.
+    self.assertTrue(result.HasField('int_message'))
+    with self.assertRaises(AttributeError):
+      _ = result.no_such_field
+
+  def test_field_keeps_arena(self):
+    destroyed = m.arenas_destroyed()
+    inner = m.build(3).int_message
+    gc.collect()
+    self.assertEqual(destroyed, m.arenas_destroyed())
+    self.assertEqual(4, inner.value)
+    del inner
+    gc.collect()
+    self.assertEqual(destroyed + 1, m.arenas_destroyed())
+
+  def test_passed_without_copy(self):
+    result = m.build(3)
+    self.assertEqual(3, m.int_value(result))
+    self.assertTrue(m.on_arena(result))
+
+  def test_arena_lifetime(self):
+    destroyed = m.arenas_destroyed()
+    result = m.build(3)
+    message = result.message
+    self.assertEqual(destroyed, m.arenas_destroyed())
+    del result
+    gc.collect()
+    self.assertEqual(destroyed + 1, m.arenas_destroyed())
+    self.assertEqual(3, message.int_value)
+
+  def test_none(self):
+    self.assertIsNone(m.build_none())
+
+
+if __name__ == '__main__':
+  absltest.main()
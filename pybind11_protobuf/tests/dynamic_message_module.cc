@@ -4,6 +4,7 @@
 // BSD-style license that can be found in the LICENSE file.
 
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
 
 #include <cassert>
 #include <cstdint>
@@ -17,6 +18,7 @@
 #include "google/protobuf/message.h"
 #include "google/protobuf/text_format.h"
 #include "pybind11_protobuf/native_proto_caster.h"
+#include "pybind11_protobuf/proto_cast_util_testing.h"
 
 namespace py = ::pybind11;
 
@@ -85,6 +87,7 @@ std::unique_ptr<::google::protobuf::Message> GetDynamicMessage(const std::string
 
 PYBIND11_MODULE(dynamic_message_module, m) {
   pybind11_protobuf::ImportNativeProtoCasters();
+  pybind11_protobuf::DefineDescriptorPoolSnapshots(m);
 
   //  Message building methods.
   m.def(
@@ -171,6 +174,26 @@ PYBIND11_MODULE(dynamic_message_module, m) {
                    : "<nullptr>";
       },
       py::arg("message"));
+
+  // Inspection of the C++ pools wrapping Python pools.
+  m.def(
+      "descriptor_pool_stats",
+      [](py::handle pool) {
+        pybind11_protobuf::testing::PythonDescriptorPoolStats stats =
+            pybind11_protobuf::testing::GetPythonDescriptorPoolStats(pool);
+        return py::make_tuple(stats.file_names, stats.python_lookups);
+      },
+      py::arg("pool"));
+
+  m.def(
+      "cached_prototype",
+      [](py::handle message) -> py::object {
+        const ::google::protobuf::Message* prototype =
+            pybind11_protobuf::PyProtoGetCachedPrototype(message);
+        if (prototype == nullptr) return py::none();
+        return py::int_(reinterpret_cast<uintptr_t>(prototype));
+      },
+      py::arg("message"));
 }
 
 }  // namespace
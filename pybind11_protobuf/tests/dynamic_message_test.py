@@ -8,6 +8,8 @@ from __future__ import absolute_import
 from __future__ import division
 from __future__ import print_function
 
+import os
+
 from absl.testing import absltest
 from absl.testing import parameterized
 from google.protobuf import descriptor_pb2
@@ -39,6 +41,52 @@ POOL.Add(
         ]))
 
 
+def make_closure_pool(a_value_number=2):
+  """Returns a pool where a.proto imports b.proto, which imports c.proto."""
+  pool = descriptor_pool.DescriptorPool()
+  pool.Add(
+      descriptor_pb2.FileDescriptorProto(
+          name='closure/c.proto',
+          package='closure',
+          message_type=[
+              descriptor_pb2.DescriptorProto(
+                  name='C',
+                  field=[
+                      descriptor_pb2.FieldDescriptorProto(
+                          name='value', number=1, type=5)
+                  ])
+          ]))
+  pool.Add(
+      descriptor_pb2.FileDescriptorProto(
+          name='closure/b.proto',
+          package='closure',
+          dependency=['closure/c.proto'],
+          message_type=[
+              descriptor_pb2.DescriptorProto(
+                  name='B',
+                  field=[
+                      descriptor_pb2.FieldDescriptorProto(
+                          name='c', number=1, type=11, type_name='.closure.C')
+                  ])
+          ]))
+  pool.Add(
+      descriptor_pb2.FileDescriptorProto(
+          name='closure/a.proto',
+          package='closure',
+          dependency=['closure/b.proto'],
+          message_type=[
+              descriptor_pb2.DescriptorProto(
+                  name='A',
+                  field=[
+                      descriptor_pb2.FieldDescriptorProto(
+                          name='b', number=1, type=11, type_name='.closure.B'),
+                      descriptor_pb2.FieldDescriptorProto(
+                          name='value', number=a_value_number, type=5)
+                  ])
+          ]))
+  return pool
+
+
 def get_py_dynamic_message(value=5):
   """Returns a dynamic message that is wire-compatible with IntMessage."""
   prototype = message_factory.GetMessageClass(
@@ -141,6 +189,102 @@ class DynamicMessageTest(parameterized.TestCase, compare.ProtoAssertions):
     b = m.print_descriptor(a)
     self.assertNotEqual(-1, b.find('value = 1'), b)
 
+  def test_loads_file_closure(self):
+    pool = make_closure_pool()
+    message_class = message_factory.GetMessageClass(
+        pool.FindMessageTypeByName('closure.A'))
+    a = message_class(value=7)
+    a.b.c.value = 8
+    self.assertTrue(m.check_message(a, 7))
+    files, python_lookups = m.descriptor_pool_stats(pool)
+    self.assertEqual(
+        files, ['closure/a.proto', 'closure/b.proto', 'closure/c.proto'])
+    # The imports were served from the closure loaded with a.proto.
+    self.assertEqual(python_lookups, 1)
+    self.assertIn('value: 8', m.print(a))
+    self.assertEqual(m.descriptor_pool_stats(pool)[1], 1)
+
+  def test_lists_only_loaded_files(self):
+    pool = make_closure_pool()
+    message_class = message_factory.GetMessageClass(
+        pool.FindMessageTypeByName('closure.B'))
+    self.assertEqual(m.descriptor_pool_stats(pool), ([], 0))
+    # B has no value field to check, but converting it loads its closure.
+    self.assertFalse(m.check_message(message_class(), 0))
+    self.assertEqual(
+        m.descriptor_pool_stats(pool)[0],
+        ['closure/b.proto', 'closure/c.proto'])
+
+  def test_prototype_cached_by_class(self):
+    pool = make_closure_pool()
+    message_class = message_factory.GetMessageClass(
+        pool.FindMessageTypeByName('closure.A'))
+    self.assertIsNone(m.cached_prototype(message_class()))
+    self.assertTrue(m.check_message(message_class(value=1), 1))
+    prototype = m.cached_prototype(message_class())
+    self.assertIsNotNone(prototype)
+    self.assertTrue(m.check_message(message_class(value=2), 2))
+    self.assertEqual(m.cached_prototype(message_class()), prototype)
+
+    # Another class of the same name has its own prototype.
+    other_class = message_factory.GetMessageClass(
+        make_closure_pool().FindMessageTypeByName('closure.A'))
+    self.assertIsNone(m.cached_prototype(other_class()))
+    self.assertTrue(m.check_message(other_class(value=3), 3))
+    self.assertNotIn(m.cached_prototype(other_class()), (None, prototype))
+
+  def _write_closure_snapshot(self, fingerprint):
+    path = os.path.join(self.create_tempdir().full_path, 'snapshot')
+    pool = make_closure_pool()
+    message_class = message_factory.GetMessageClass(
+        pool.FindMessageTypeByName('closure.A'))
+    self.assertTrue(m.check_message(message_class(value=7), 7))
+    self.assertTrue(m.write_descriptor_pool_snapshot(pool, path, fingerprint))
+    return path
+
+  def test_snapshot_roundtrip(self):
+    path = self._write_closure_snapshot('v1')
+    pool = make_closure_pool()
+    self.assertTrue(m.load_descriptor_pool_snapshot(pool, path, 'v1'))
+    message_class = message_factory.GetMessageClass(
+        pool.FindMessageTypeByName('closure.A'))
+    self.assertTrue(m.check_message(message_class(value=8), 8))
+    files, python_lookups = m.descriptor_pool_stats(pool)
+    self.assertEqual(
+        files, ['closure/a.proto', 'closure/b.proto', 'closure/c.proto'])
+    self.assertEqual(python_lookups, 0)
+
+  def test_stale_snapshot(self):
+    path = self._write_closure_snapshot('v1')
+    pool = make_closure_pool()
+    self.assertFalse(m.load_descriptor_pool_snapshot(pool, path, 'v2'))
+    self.assertEqual(m.descriptor_pool_stats(pool), ([], 0))
+    message_class = message_factory.GetMessageClass(
+        pool.FindMessageTypeByName('closure.A'))
+    self.assertTrue(m.check_message(message_class(value=8), 8))
+    self.assertEqual(m.descriptor_pool_stats(pool)[1], 1)
+
+  def test_snapshot_file_changed(self):
+    path = self._write_closure_snapshot('v1')
+    # Same fingerprint, but a.proto differs from the snapshot.
+    pool = make_closure_pool(a_value_number=3)
+    self.assertTrue(m.load_descriptor_pool_snapshot(pool, path, 'v1'))
+    self.assertEqual(m.descriptor_pool_stats(pool)[0],
+                     ['closure/b.proto', 'closure/c.proto'])
+    message_class = message_factory.GetMessageClass(
+        pool.FindMessageTypeByName('closure.A'))
+    self.assertTrue(m.check_message(message_class(value=8), 8))
+    # a.proto was loaded from Python.
+    self.assertEqual(m.descriptor_pool_stats(pool)[1], 1)
+
+  def test_invalid_snapshot(self):
+    pool = make_closure_pool()
+    path = os.path.join(self.create_tempdir().full_path, 'snapshot')
+    self.assertFalse(m.load_descriptor_pool_snapshot(pool, path, 'v1'))
+    with open(path, 'wb') as f:
+      f.write(b'not a snapshot')
+    self.assertFalse(m.load_descriptor_pool_snapshot(pool, path, 'v1'))
+
 
 if __name__ == '__main__':
   absltest.main()
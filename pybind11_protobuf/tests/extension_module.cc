@@ -8,6 +8,7 @@
 #include <functional>
 #include <memory>
 #include <stdexcept>
+#include <string>
 
 #include "google/protobuf/message.h"
 #include "pybind11_protobuf/native_proto_caster.h"
@@ -70,9 +71,17 @@ PYBIND11_MODULE(extension_module, m) {
       py::arg("message"), py::return_value_policy::copy);
 
   DefReserialize<BaseMessage>(m, "reserialize_base_message");
+  DefReserialize<pybind11::test::NestLevel1>(m, "reserialize_nest_level1");
   DefReserialize<pybind11::test::NestLevel2>(m, "reserialize_nest_level2");
   DefReserialize<pybind11::test::NestRepeated>(m, "reserialize_nest_repeated");
 
+  m.def(
+      "allow_unknown_fields_for",
+      [](const std::string& top_message, const std::string& field_path) {
+        pybind11_protobuf::AllowUnknownFieldsFor(top_message, field_path);
+      },
+      py::arg("top_message"), py::arg("field_path"));
+
   pybind11_protobuf::AllowUnknownFieldsFor("pybind11.test.AllowUnknownInner",
                                            "");
   DefReserialize<pybind11::test::AllowUnknownInner>(
@@ -8,6 +8,8 @@ from __future__ import absolute_import
 from __future__ import division
 from __future__ import print_function
 
+import threading
+
 from absl.testing import absltest
 from absl.testing import parameterized
 
@@ -213,5 +215,39 @@ class ExtensionTest(parameterized.TestCase):
     b = m.reserialize_base_message(a)
     self.assertEqual(a.SerializeToString(), b.SerializeToString())
 
+  def test_allow_unknown_fields_added_after_check(self):
+    a = extension_pb2.NestLevel1(
+        base_msg=get_py_message(in_other_file_value=41))
+    if unknown_field_exception_is_expected():
+      # The check compiles the lookup; adding to the allow-list must
+      # invalidate it.
+      with self.assertRaises(ValueError):
+        m.reserialize_nest_level1(a)
+    m.allow_unknown_fields_for('pybind11.test.NestLevel1', 'base_msg')
+    b = m.reserialize_nest_level1(a)
+    self.assertEqual(a.SerializeToString(), b.SerializeToString())
+
+  def test_reserialize_from_threads(self):
+    a = extension_pb2.NestLevel2(
+        nest_lvl1=extension_pb2.NestLevel1(base_msg=get_py_message(value=7)))
+    errors = []
+
+    def reserialize():
+      try:
+        for _ in range(100):
+          b = m.reserialize_nest_level2(a)
+          if b.SerializeToString() != a.SerializeToString():
+            errors.append(b)
+      except Exception as e:  # pylint: disable=broad-except
+        errors.append(e)
+
+    threads = [threading.Thread(target=reserialize) for _ in range(8)]
+    for t in threads:
+      t.start()
+    for t in threads:
+      t.join()
+    self.assertEmpty(errors)
+
+
 if __name__ == '__main__':
   absltest.main()
@@ -0,0 +1,58 @@
+// Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+//
+// All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include <pybind11/pybind11.h>
+
+#include <cstdint>
+#include <string>
+
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/message.h"
+#include "pybind11_protobuf/native_proto_caster.h"
+#include "pybind11_protobuf/tests/test.pb.h"
+
+namespace py = ::pybind11;
+
+namespace {
+
+using ::pybind11::test::IntMessage;
+
+PYBIND11_MODULE(frozen_proto_module, m) {
+  pybind11_protobuf::ImportNativeProtoCasters();
+  pybind11_protobuf::DefineFrozenProtos(m);
+
+  m.def("get_value", [](const IntMessage& message) { return message.value(); });
+
+  m.def("get_value_by_copy", [](IntMessage message) {
+    message.set_value(message.value() + 1);
+    return message.value();
+  });
+
+  m.def("full_name", [](const ::google::protobuf::Message& message) {
+    return message.GetDescriptor()->full_name();
+  });
+
+  // Whether the C++ message is of a generated type.
+  m.def("is_generated", [](const ::google::protobuf::Message& message) {
+    return message.GetDescriptor()->file()->pool() ==
+           ::google::protobuf::DescriptorPool::generated_pool();
+  });
+
+  // Reads a field through the reflection of the message's own descriptor.
+  m.def("get_field", [](const ::google::protobuf::Message& message,
+                        const std::string& name) {
+    const auto* field = message.GetDescriptor()->FindFieldByName(name);
+    if (field == nullptr) throw py::key_error(name);
+    return message.GetReflection()->GetInt32(message, field);
+  });
+
+  // Returns the address of the C++ message, which is stable across calls for
+  // a frozen message.
+  m.def("address", [](const IntMessage& message) {
+    return reinterpret_cast<uintptr_t>(&message);
+  });
+}
+
+}  // namespace
@@ -0,0 +1,119 @@
+# Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+#
+# All rights reserved. Use of this source code is governed by a
+# BSD-style license that can be found in the LICENSE file.
+"""Tests for freeze() and FrozenMessage."""
+
+from absl.testing import absltest
+from google.protobuf import descriptor_pb2
+from google.protobuf import descriptor_pool
+from google.protobuf import message_factory
+
+from pybind11_protobuf.tests import frozen_proto_module as m
+from pybind11_protobuf.tests import test_pb2
+
+
+class FakeDescriptor:
+  full_name = 'pybind11.test.IntMessage'
+
+
+class CountingMessage:
+  """Claims to be an IntMessage, and counts serializations."""
+
+  DESCRIPTOR = FakeDescriptor()
+
+  def __init__(self, value):
+    self.serialized = 0
+    self._bytes = test_pb2.IntMessage(value=value).SerializeToString()
+
+  def SerializePartialToString(self):  # pylint: disable=invalid-name
+    self.serialized += 1
+    return self._bytes
+
+
+def get_int_message_class(value_field_name='value'):
+  """Returns IntMessage from a copy of test.proto in a new pool."""
+  file_proto = descriptor_pb2.FileDescriptorProto.FromString(
+      test_pb2.DESCRIPTOR.serialized_pb)
+  for message_type in file_proto.message_type:
+    if message_type.name == 'IntMessage':
+      message_type.field[0].name = value_field_name
+  pool = descriptor_pool.DescriptorPool()
+  pool.Add(file_proto)
+  return message_factory.GetMessageClass(
+      pool.FindMessageTypeByName('pybind11.test.IntMessage'))
+
+
+class FrozenProtoTest(absltest.TestCase):
+
+  def test_get_value(self):
+    frozen = m.freeze(test_pb2.IntMessage(value=5))
+    self.assertIsInstance(frozen, m.FrozenMessage)
+    self.assertEqual(5, m.get_value(frozen))
+    self.assertEqual(6, m.get_value_by_copy(frozen))
+    self.assertEqual(5, m.get_value(frozen))
+
+  def test_converted_once(self):
+    message = CountingMessage(7)
+    frozen = m.freeze(message)
+    self.assertEqual(1, message.serialized)
+    for _ in range(3):
+      self.assertEqual(7, m.get_value(frozen))
+    self.assertEqual(1, message.serialized)
+
+  def test_same_cpp_message(self):
+    frozen = m.freeze(test_pb2.IntMessage(value=5))
+    self.assertEqual(m.address(frozen), m.address(frozen))
+
+  def test_snapshot(self):
+    message = test_pb2.IntMessage(value=5)
+    frozen = m.freeze(message)
+    message.value = 6
+    self.assertEqual(5, m.get_value(frozen))
+    self.assertIs(message, frozen.message)
+
+  def test_freeze_frozen(self):
+    frozen = m.freeze(test_pb2.IntMessage(value=5))
+    self.assertIs(frozen, m.freeze(frozen))
+
+  def test_generic(self):
+    frozen = m.freeze(test_pb2.IntMessage(value=5))
+    self.assertEqual('pybind11.test.IntMessage', m.full_name(frozen))
+    self.assertEqual('pybind11.test.IntMessage', frozen.DESCRIPTOR.full_name)
+
+  def test_serialize(self):
+    message = test_pb2.IntMessage(value=5)
+    frozen = m.freeze(message)
+    self.assertEqual(message, test_pb2.IntMessage.FromString(
+        frozen.SerializePartialToString()))
+
+  def test_wrong_type(self):
+    frozen = m.freeze(test_pb2.TestMessage())
+    with self.assertRaises(TypeError):
+      m.get_value(frozen)
+    with self.assertRaises(TypeError):
+      m.freeze(1)
+
+  def test_other_pool_generic(self):
+    # Generic loads keep the type of the message's own pool, even when it is
+    # identical to the generated type.
+    message = get_int_message_class()(value=5)
+    self.assertFalse(m.is_generated(message))
+    self.assertEqual(5, m.get_field(message, 'value'))
+
+  def test_other_pool_frozen(self):
+    # freeze() asks for the generated type, which identical types use.
+    frozen = m.freeze(get_int_message_class()(value=5))
+    self.assertTrue(m.is_generated(frozen))
+    self.assertEqual(5, m.get_value(frozen))
+    self.assertEqual(m.address(frozen), m.address(frozen))
+
+  def test_other_pool_frozen_different_type(self):
+    frozen = m.freeze(get_int_message_class('other_value')(other_value=5))
+    self.assertFalse(m.is_generated(frozen))
+    self.assertEqual(5, m.get_field(frozen, 'other_value'))
+    self.assertEqual(5, m.get_value(frozen))
+
+
+if __name__ == '__main__':
+  absltest.main()
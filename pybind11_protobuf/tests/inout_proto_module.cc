@@ -0,0 +1,58 @@
+// Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+//
+// All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include <pybind11/pybind11.h>
+
+#include <stdexcept>
+#include <string>
+
+#include "google/protobuf/message.h"
+#include "pybind11_protobuf/inout_proto.h"
+#include "pybind11_protobuf/native_proto_caster.h"
+#include "pybind11_protobuf/tests/test.pb.h"
+
+namespace py = ::pybind11;
+
+namespace {
+
+using ::pybind11::test::IntMessage;
+using ::pybind11::test::TestMessage;
+using ::pybind11_protobuf::InOut;
+
+PYBIND11_MODULE(inout_proto_module, m) {
+  pybind11_protobuf::ImportNativeProtoCasters();
+
+  m.def("increment", [](InOut<IntMessage> message) {
+    message->set_value(message->value() + 1);
+  });
+
+  m.def("unchanged", [](InOut<IntMessage> message) { return message->value(); });
+
+  m.def("increment_and_throw", [](InOut<IntMessage> message) {
+    message->set_value(message->value() + 1);
+    throw std::runtime_error("failed");
+  });
+
+  // Replaces string_value, appends to repeated_int_value and clears
+  // int_value, leaving the other fields as they are.
+  m.def("update", [](InOut<TestMessage> message) {
+    message->set_string_value("updated");
+    message->add_repeated_int_value(message->repeated_int_value_size());
+    message->clear_int_value();
+  });
+
+  m.def("set_value", [](InOut<::google::protobuf::Message> message, int value) {
+    const auto* field = message->GetDescriptor()->FindFieldByName("value");
+    message->GetReflection()->SetInt32(message.get(), field, value);
+  });
+
+  m.def("overload", [](InOut<IntMessage> message, int) {
+    message->set_value(-1);
+    return 1;
+  });
+  m.def("overload", [](InOut<IntMessage>, const std::string&) { return 2; });
+}
+
+}  // namespace
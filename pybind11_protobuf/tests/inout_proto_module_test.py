@@ -0,0 +1,93 @@
+# Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+#
+# All rights reserved. Use of this source code is governed by a
+# BSD-style license that can be found in the LICENSE file.
+"""Tests for InOut<T> proto parameters."""
+
+from absl.testing import absltest
+
+from pybind11_protobuf.tests import inout_proto_module as m
+from pybind11_protobuf.tests import test_pb2
+
+
+class FakeDescriptor:
+  full_name = 'pybind11.test.IntMessage'
+
+
+class RecordingMessage:
+  """Claims to be an IntMessage, and records the calls writing to it."""
+
+  DESCRIPTOR = FakeDescriptor()
+
+  def __init__(self, value):
+    self.calls = []
+    self.message = test_pb2.IntMessage(value=value)
+
+  def SerializePartialToString(self):  # pylint: disable=invalid-name
+    return self.message.SerializePartialToString()
+
+  def ClearField(self, name):  # pylint: disable=invalid-name
+    self.calls.append(('ClearField', name))
+    self.message.ClearField(name)
+
+  def MergeFromString(self, serialized):  # pylint: disable=invalid-name
+    self.calls.append(('MergeFromString',))
+    self.message.MergeFromString(serialized)
+
+
+class InOutProtoTest(absltest.TestCase):
+
+  def test_in_place(self):
+    message = test_pb2.IntMessage(value=5)
+    m.increment(message)
+    self.assertEqual(6, message.value)
+
+  def test_only_changes_written(self):
+    message = RecordingMessage(5)
+    self.assertEqual(5, m.unchanged(message))
+    self.assertEqual([], message.calls)
+    m.increment(message)
+    self.assertEqual(6, message.message.value)
+    self.assertEqual([('MergeFromString',)], message.calls)
+
+  def test_cleared_field(self):
+    message = RecordingMessage(-1)
+    m.increment(message)
+    self.assertEqual(0, message.message.value)
+    self.assertEqual([('ClearField', 'value')], message.calls)
+
+  def test_fields(self):
+    message = test_pb2.TestMessage(
+        string_value='old', int_value=3, repeated_int_value=[7])
+    message.int_message.value = 9
+    m.update(message)
+    self.assertEqual('updated', message.string_value)
+    self.assertEqual(0, message.int_value)
+    self.assertEqual([7, 1], list(message.repeated_int_value))
+    self.assertEqual(9, message.int_message.value)
+
+  def test_generic(self):
+    message = test_pb2.IntMessage(value=5)
+    m.set_value(message, 8)
+    self.assertEqual(8, message.value)
+
+  def test_written_on_exception(self):
+    message = test_pb2.IntMessage(value=5)
+    with self.assertRaises(RuntimeError):
+      m.increment_and_throw(message)
+    self.assertEqual(6, message.value)
+
+  def test_overload_resolution(self):
+    message = RecordingMessage(5)
+    self.assertEqual(2, m.overload(message, 'a'))
+    self.assertEqual([], message.calls)
+    self.assertEqual(1, m.overload(message, 1))
+    self.assertEqual(-1, message.message.value)
+
+  def test_none(self):
+    with self.assertRaises(TypeError):
+      m.increment(None)
+
+
+if __name__ == '__main__':
+  absltest.main()
@@ -0,0 +1,54 @@
+// Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+//
+// All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include <pybind11/pybind11.h>
+
+#include <cstdint>
+#include <thread>
+
+#include "pybind11_protobuf/lazy_proto.h"
+#include "pybind11_protobuf/native_proto_caster.h"
+#include "pybind11_protobuf/tests/test.pb.h"
+
+namespace py = ::pybind11;
+
+namespace {
+
+using ::pybind11::test::IntMessage;
+using ::pybind11::test::TestMessage;
+using ::pybind11_protobuf::Lazy;
+
+PYBIND11_MODULE(lazy_proto_module, m) {
+  pybind11_protobuf::ImportNativeProtoCasters();
+
+  // Returns the value of message if use is set, and reads it twice.
+  m.def(
+      "get_value",
+      [](const Lazy<IntMessage>& message, bool use) -> int32_t {
+        if (!use) return -1;
+        if (message.is_none()) return -2;
+        return message->value() + (*message).value() - message.get()->value();
+      },
+      py::arg("message"), py::arg("use") = true);
+
+  // As above, converting on a C++ thread without the GIL.
+  m.def(
+      "get_value_from_thread",
+      [](Lazy<IntMessage> message) {
+        int32_t value = 0;
+        std::thread([&] { value = message->value(); }).join();
+        return value;
+      },
+      py::call_guard<py::gil_scoped_release>());
+
+  m.def("get_full_name", [](const Lazy<::google::protobuf::Message>& message) {
+    return message->GetDescriptor()->full_name();
+  });
+
+  m.def("overload", [](const Lazy<IntMessage>&) { return 1; });
+  m.def("overload", [](const Lazy<TestMessage>&) { return 2; });
+}
+
+}  // namespace
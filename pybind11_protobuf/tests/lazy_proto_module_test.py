@@ -0,0 +1,68 @@
+# Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+#
+# All rights reserved. Use of this source code is governed by a
+# BSD-style license that can be found in the LICENSE file.
+"""Tests for Lazy<T> proto arguments."""
+
+from absl.testing import absltest
+
+from pybind11_protobuf.tests import lazy_proto_module as m
+from pybind11_protobuf.tests import test_pb2
+
+
+class FakeDescriptor:
+  full_name = 'pybind11.test.IntMessage'
+
+
+class CountingMessage:
+  """Claims to be an IntMessage, and counts serializations."""
+
+  DESCRIPTOR = FakeDescriptor()
+
+  def __init__(self, value):
+    self.serialized = 0
+    self._bytes = test_pb2.IntMessage(value=value).SerializeToString()
+
+  def SerializePartialToString(self):  # pylint: disable=invalid-name
+    self.serialized += 1
+    return self._bytes
+
+
+class LazyProtoTest(absltest.TestCase):
+
+  def test_get(self):
+    self.assertEqual(5, m.get_value(test_pb2.IntMessage(value=5)))
+
+  def test_none(self):
+    self.assertEqual(-2, m.get_value(None))
+
+  def test_unused_is_not_converted(self):
+    message = CountingMessage(5)
+    self.assertEqual(-1, m.get_value(message, use=False))
+    self.assertEqual(0, message.serialized)
+
+  def test_converted_once(self):
+    message = CountingMessage(5)
+    self.assertEqual(5, m.get_value(message))
+    self.assertEqual(1, message.serialized)
+
+  def test_get_from_thread(self):
+    self.assertEqual(3, m.get_value_from_thread(test_pb2.IntMessage(value=3)))
+
+  def test_generic(self):
+    self.assertEqual('pybind11.test.TestMessage',
+                     m.get_full_name(test_pb2.TestMessage()))
+
+  def test_wrong_type(self):
+    with self.assertRaises(TypeError):
+      m.get_value(test_pb2.TestMessage())
+    with self.assertRaises(TypeError):
+      m.get_value(1)
+
+  def test_overload(self):
+    self.assertEqual(1, m.overload(test_pb2.IntMessage()))
+    self.assertEqual(2, m.overload(test_pb2.TestMessage()))
+
+
+if __name__ == '__main__':
+  absltest.main()
@@ -6,10 +6,15 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <memory>
+#include <string>
 
+#include "absl/strings/cord.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include "absl/types/variant.h"
 #include "google/protobuf/descriptor.h"
@@ -38,6 +43,7 @@ struct type_caster<absl::monostate>
 namespace {
 
 using ::pybind11::test::IntMessage;
+using ::pybind11::test::TestMessage;
 
 bool CheckIntMessage(const IntMessage* message, int32_t value) {
   return message ? message->value() == value : false;
@@ -88,6 +94,52 @@ PYBIND11_MODULE(pass_by_module, m) {
       "static_ref_auto", []() -> IntMessage& { return *GetStatic(); },
       py::return_value_policy::automatic_reference);
 
+  // interning of results, keyed by value; values from 100 are not interned.
+  m.def("set_interning_capacity", [](size_t capacity) {
+    pybind11_protobuf::EnableProtoResultInterning(
+        IntMessage::GetDescriptor(), capacity,
+        [](const ::google::protobuf::Message& message)
+            -> absl::optional<std::string> {
+          int32_t value = message.GetReflection()->GetInt32(
+              message, message.GetDescriptor()->FindFieldByName("value"));
+          if (value >= 100) return absl::nullopt;
+          return absl::StrCat(value);
+        });
+  });
+  m.def("interning_stats", []() {
+    pybind11_protobuf::ProtoInternStats stats =
+        pybind11_protobuf::GetProtoResultInterningStats(
+            IntMessage::GetDescriptor());
+    return py::make_tuple(stats.hits, stats.misses, stats.evictions,
+                          stats.size);
+  });
+
+  // large messages, parsed from a Cord sharing the serialized bytes.
+  m.def("bytes_as_cord_is_shared", [](py::bytes bytes) {
+    absl::Cord cord = pybind11_protobuf::PyBytesAsCord(bytes);
+    absl::optional<absl::string_view> flat = cord.TryFlat();
+    return flat.has_value() &&
+           flat->data() == pybind11_protobuf::PyBytesAsStringView(bytes).data();
+  });
+  m.def("string_value_size", [](const TestMessage& message) {
+    return message.string_value().size();
+  });
+  m.def("make_large_message", [](size_t size) {
+    TestMessage message;
+    message.set_string_value(std::string(size, 'x'));
+    return message;
+  });
+
+  // large conversions.
+  m.def("set_large_conversion_threshold", [](size_t bytes) {
+    return pybind11_protobuf::SetLargeConversionThreshold(bytes);
+  });
+  m.def("large_conversion_stats", []() {
+    pybind11_protobuf::LargeConversionStats stats =
+        pybind11_protobuf::GetLargeConversionStats();
+    return py::make_tuple(stats.buffers, stats.bytes, stats.bytes_in_use);
+  });
+
   // concrete.
   m.def(
       "concrete",
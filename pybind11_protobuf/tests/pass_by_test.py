@@ -7,6 +7,8 @@ from __future__ import absolute_import
 from __future__ import division
 from __future__ import print_function
 
+import sys
+
 from absl.testing import absltest
 from absl.testing import parameterized
 from google.protobuf import descriptor_pool
@@ -198,6 +200,75 @@ class PassByTest(parameterized.TestCase):
     with self.assertRaisesRegex(TypeError, r' object is not a valid protobuf$'):
       m.fn_overload(FakeProto(b''))
 
+  def test_bytes_as_cord(self):
+    data = b'x' * 1000
+    refcount = sys.getrefcount(data)
+    self.assertTrue(m.bytes_as_cord_is_shared(data))
+    self.assertEqual(refcount, sys.getrefcount(data))
+
+  def test_large_message(self):
+    size = 1 << 20
+    message = test_pb2.TestMessage(string_value='x' * size)
+    self.assertEqual(size, m.string_value_size(message))
+
+  def test_large_conversion(self):
+    buffers, total, _ = m.large_conversion_stats()
+    # IntMessage(value=123456) serializes to 4 bytes, value=5 to 2 bytes.
+    previous = m.set_large_conversion_threshold(3)
+    try:
+      self.assertEqual(3, m.set_large_conversion_threshold(3))
+      self.assertEqual(123456, m.make_int_message(123456).value)
+      self.assertEqual((buffers + 1, total + 4, 0), m.large_conversion_stats())
+      # Smaller messages still use the heap.
+      self.assertEqual(5, m.make_int_message(5).value)
+      self.assertEqual((buffers + 1, total + 4, 0), m.large_conversion_stats())
+      # Each conversion maps its own buffer, unmapped once it is parsed.
+      messages = [m.make_int_message(123456) for _ in range(3)]
+      self.assertEqual([123456] * 3, [x.value for x in messages])
+      self.assertEqual((buffers + 4, total + 16, 0), m.large_conversion_stats())
+    finally:
+      m.set_large_conversion_threshold(previous)
+
+  def test_interned_results(self):
+    m.set_interning_capacity(2)
+    try:
+      first = m.static_cref()
+      second = m.static_cref()
+      self.assertEqual(4, second.value)
+      self.assertIsNot(first, second)
+      # (hits, misses, evictions, size)
+      self.assertEqual((1, 1, 0, 1), m.interning_stats())
+      # Results are copies, so changing one leaves the cache intact.
+      second.value = 5
+      self.assertEqual(4, m.static_cref().value)
+      self.assertEqual((2, 1, 0, 1), m.interning_stats())
+    finally:
+      m.set_interning_capacity(0)
+    self.assertEqual((0, 0, 0, 0), m.interning_stats())
+
+  def test_interned_results_lru_eviction(self):
+    m.set_interning_capacity(2)
+    try:
+      for value in (1, 2, 1, 3):
+        self.assertEqual(value, m.make_int_message(value).value)
+      # 3 evicted 2, the least recently used.
+      self.assertEqual((1, 3, 1, 2), m.interning_stats())
+      self.assertEqual(1, m.make_int_message(1).value)
+      self.assertEqual((2, 3, 1, 2), m.interning_stats())
+      self.assertEqual(2, m.make_int_message(2).value)
+      self.assertEqual((2, 4, 2, 2), m.interning_stats())
+    finally:
+      m.set_interning_capacity(0)
+
+  def test_interned_results_without_key(self):
+    m.set_interning_capacity(2)
+    try:
+      for _ in range(2):
+        self.assertEqual(100, m.make_int_message(100).value)
+      self.assertEqual((0, 0, 0, 0), m.interning_stats())
+    finally:
+      m.set_interning_capacity(0)
+
 
 if __name__ == '__main__':
   absltest.main()
@@ -0,0 +1,89 @@
+// Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+//
+// All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include <pybind11/pybind11.h>
+
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "pybind11_protobuf/proto_awaitable.h"
+#include "pybind11_protobuf/tests/test.pb.h"
+#include "pybind11_protobuf/tests/we-love-dashes.pb.h"
+#include "pybind11_protobuf/wrapped_proto_caster.h"
+
+namespace py = ::pybind11;
+
+namespace {
+
+using ::pybind11::test::IntMessage;
+using ::pybind11::test::TokenEffort;
+using ::pybind11_protobuf::MakeProtoAwaitable;
+using ::pybind11_protobuf::ProtoCompletion;
+using ::pybind11_protobuf::WithAwaitableProtos;
+using ::pybind11_protobuf::WithWrappedProtos;
+
+std::future<IntMessage> AddLater(const IntMessage& message, int32_t delta) {
+  int32_t value = message.value();
+  return std::async(std::launch::async, [value, delta] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    IntMessage result;
+    result.set_value(value + delta);
+    return result;
+  });
+}
+
+std::future<absl::StatusOr<IntMessage>> FailLater(std::string message) {
+  return std::async(std::launch::async,
+                    [message]() -> absl::StatusOr<IntMessage> {
+                      return absl::InvalidArgumentError(message);
+                    });
+}
+
+std::future<IntMessage> AddDeferred(const IntMessage& message, int32_t delta) {
+  int32_t value = message.value();
+  return std::async(std::launch::deferred, [value, delta] {
+    IntMessage result;
+    result.set_value(value + delta);
+    return result;
+  });
+}
+
+// TokenEffort has no Python module, so its result cannot be converted.
+std::future<TokenEffort> TokenEffortLater() {
+  return std::async(std::launch::async, [] { return TokenEffort(); });
+}
+
+PYBIND11_MODULE(proto_awaitable_module, m) {
+  pybind11_protobuf::ImportWrappedProtoCasters();
+
+  m.def("add_later", WithAwaitableProtos(&AddLater), py::arg("message"),
+        py::arg("delta"));
+  m.def("add_deferred", WithAwaitableProtos(&AddDeferred), py::arg("message"),
+        py::arg("delta"));
+  m.def("fail_later", WithAwaitableProtos(&FailLater), py::arg("message"));
+  m.def("token_effort_later", WithAwaitableProtos(&TokenEffortLater));
+
+  m.def(
+      "make_int_message_async",
+      [](int32_t value) {
+        return MakeProtoAwaitable<IntMessage>(
+            [value](ProtoCompletion<IntMessage> done) {
+              std::thread([value, done]() {
+                IntMessage result;
+                result.set_value(value);
+                done(std::move(result));
+              }).detach();
+            });
+      },
+      py::arg("value"));
+}
+
+}  // namespace
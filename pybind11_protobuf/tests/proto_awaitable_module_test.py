@@ -0,0 +1,80 @@
+# Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+#
+# All rights reserved. Use of this source code is governed by a
+# BSD-style license that can be found in the LICENSE file.
+"""Tests for awaitable proto bindings."""
+
+import asyncio
+
+from absl.testing import absltest
+
+from pybind11_protobuf.tests import proto_awaitable_module as m
+from pybind11_protobuf.tests import test_pb2
+
+
+class ProtoAwaitableTest(absltest.TestCase):
+
+  def test_future(self):
+
+    async def run():
+      return await m.add_later(test_pb2.IntMessage(value=5), 3)
+
+    result = asyncio.run(run())
+    self.assertIsInstance(result, test_pb2.IntMessage)
+    self.assertEqual(8, result.value)
+
+  def test_future_status(self):
+
+    async def run():
+      return await m.fail_later('nope')
+
+    with self.assertRaisesRegex(RuntimeError, 'nope') as ctx:
+      asyncio.run(run())
+    # absl::StatusCode::kInvalidArgument.
+    self.assertEqual(3, ctx.exception.code)
+
+  def test_result_without_python_module(self):
+
+    async def run():
+      return await asyncio.wait_for(m.token_effort_later(), timeout=10)
+
+    with self.assertRaisesRegex(TypeError, 'pybind11.test.TokenEffort'):
+      asyncio.run(run())
+
+  def test_completion(self):
+
+    async def run():
+      return await m.make_int_message_async(11)
+
+    self.assertEqual(11, asyncio.run(run()).value)
+
+  def test_gather(self):
+
+    async def run():
+      return await asyncio.gather(
+          *[m.add_later(test_pb2.IntMessage(value=i), 1) for i in range(10)])
+
+    self.assertEqual(list(range(1, 11)), [r.value for r in asyncio.run(run())])
+
+  def test_gather_many(self):
+
+    async def run():
+      return await asyncio.gather(
+          *[m.add_later(test_pb2.IntMessage(value=i), 1) for i in range(200)])
+
+    self.assertEqual(list(range(1, 201)), [r.value for r in asyncio.run(run())])
+
+  def test_deferred_future(self):
+
+    async def run():
+      return await m.add_deferred(test_pb2.IntMessage(value=2), 5)
+
+    self.assertEqual(7, asyncio.run(run()).value)
+
+  def test_requires_running_loop(self):
+    with self.assertRaises(RuntimeError):
+      m.make_int_message_async(1)
+
+
+if __name__ == '__main__':
+  absltest.main()
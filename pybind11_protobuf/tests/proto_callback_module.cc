@@ -0,0 +1,70 @@
+// Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+//
+// All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include <pybind11/pybind11.h>
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "pybind11_protobuf/native_proto_caster.h"
+#include "pybind11_protobuf/proto_callback.h"
+#include "pybind11_protobuf/tests/test.pb.h"
+
+namespace py = ::pybind11;
+
+namespace {
+
+using ::pybind11::test::IntMessage;
+using ::pybind11_protobuf::ProtoCallback;
+
+std::vector<IntMessage> MakeMessages(int32_t n) {
+  std::vector<IntMessage> messages(n);
+  for (int32_t i = 0; i < n; ++i) messages[i].set_value(i);
+  return messages;
+}
+
+PYBIND11_MODULE(proto_callback_module, m) {
+  pybind11_protobuf::ImportNativeProtoCasters();
+
+  // Calls handler with values [0, n), one call at a time.
+  m.def(
+      "call_each",
+      [](ProtoCallback<IntMessage> handler, int32_t n) {
+        for (const IntMessage& message : MakeMessages(n)) handler(message);
+      },
+      py::arg("handler"), py::arg("n"));
+
+  // As above, with a single GIL hold.
+  m.def(
+      "call_batch",
+      [](ProtoCallback<IntMessage> handler, int32_t n) {
+        handler.CallEach(MakeMessages(n));
+      },
+      py::arg("handler"), py::arg("n"));
+
+  // Calls handler from a C++ thread, without the GIL.
+  m.def(
+      "call_from_thread",
+      [](ProtoCallback<IntMessage> handler, int32_t n) {
+        std::thread([handler, n] {
+          for (const IntMessage& message : MakeMessages(n)) handler(message);
+        }).join();
+      },
+      py::arg("handler"), py::arg("n"),
+      py::call_guard<py::gil_scoped_release>());
+
+  m.def("call_generic", [](ProtoCallback<::google::protobuf::Message> handler,
+                           const IntMessage& message) { handler(message); });
+
+  m.def("round_trip",
+        [](ProtoCallback<IntMessage> handler) { return handler; });
+
+  m.def("has_handler", [](ProtoCallback<IntMessage> handler) {
+    return static_cast<bool>(handler);
+  });
+}
+
+}  // namespace
@@ -0,0 +1,88 @@
+# Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+#
+# All rights reserved. Use of this source code is governed by a
+# BSD-style license that can be found in the LICENSE file.
+"""Tests for proto callback bindings."""
+
+from absl.testing import absltest
+from absl.testing import parameterized
+
+from pybind11_protobuf.tests import proto_callback_module as m
+from pybind11_protobuf.tests import test_pb2
+
+
+class ProtoCallbackTest(parameterized.TestCase):
+
+  @parameterized.parameters(m.call_each, m.call_batch, m.call_from_thread)
+  def test_values(self, call):
+    values = []
+    call(lambda message: values.append(message.value), 5)
+    self.assertEqual([0, 1, 2, 3, 4], values)
+
+  def test_type(self):
+    messages = []
+    m.call_each(messages.append, 1)
+    self.assertIsInstance(messages[0], test_pb2.IntMessage)
+
+  def test_kept_messages_are_distinct(self):
+    messages = []
+    m.call_batch(messages.append, 3)
+    self.assertEqual([0, 1, 2], [x.value for x in messages])
+
+  @parameterized.parameters(m.call_each, m.call_batch)
+  def test_reuse_message(self, call):
+    seen = []
+
+    def handler(message):
+      seen.append((id(message), message.value))
+
+    handler.pybind11_protobuf_reuse_message = True
+    call(handler, 3)
+    self.assertEqual([0, 1, 2], [value for _, value in seen])
+    self.assertLen(set(ident for ident, _ in seen), 1)
+
+  def test_reuse_message_kept_anyway(self):
+    messages = []
+
+    def handler(message):
+      messages.append(message)
+
+    handler.pybind11_protobuf_reuse_message = True
+    m.call_each(handler, 3)
+    # The callback stops reusing a message once the handler keeps it.
+    self.assertEqual([0, 1, 2], [x.value for x in messages])
+
+  def test_exception(self):
+
+    def handler(message):
+      raise ValueError('bad %d' % message.value)
+
+    with self.assertRaisesRegex(ValueError, 'bad 0'):
+      m.call_each(handler, 1)
+
+  def test_generic(self):
+    messages = []
+    m.call_generic(messages.append, test_pb2.IntMessage(value=7))
+    self.assertEqual(test_pb2.IntMessage(value=7), messages[0])
+
+  def test_not_callable(self):
+    with self.assertRaises(TypeError):
+      m.call_each(1, 1)
+
+  def test_none(self):
+    self.assertFalse(m.has_handler(None))
+    self.assertTrue(m.has_handler(lambda message: None))
+    self.assertIsNone(m.round_trip(None))
+
+  @parameterized.parameters(m.call_each, m.call_batch)
+  def test_call_none(self, call):
+    with self.assertRaises(RuntimeError):
+      call(None, 1)
+
+  def test_round_trip(self):
+    handler = lambda message: None
+    self.assertIs(handler, m.round_trip(handler))
+
+
+if __name__ == '__main__':
+  absltest.main()
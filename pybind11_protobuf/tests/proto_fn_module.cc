@@ -0,0 +1,64 @@
+// Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+//
+// All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include <pybind11/pybind11.h>
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include "pybind11_protobuf/native_proto_caster.h"
+#include "pybind11_protobuf/proto_fn.h"
+#include "pybind11_protobuf/tests/test.pb.h"
+
+namespace py = ::pybind11;
+
+namespace {
+
+using ::pybind11::test::IntMessage;
+using ::pybind11::test::TestMessage;
+using ::pybind11_protobuf::def_proto_fn;
+
+IntMessage AddOne(const IntMessage& message) {
+  IntMessage result;
+  result.set_value(message.value() + 1);
+  return result;
+}
+
+PYBIND11_MODULE(proto_fn_module, m) {
+  pybind11_protobuf::ImportNativeProtoCasters();
+
+  def_proto_fn(m, "add_one", &AddOne, "Returns message.value + 1.");
+
+  def_proto_fn(m, "scale", [](const IntMessage& message, int32_t factor) {
+    IntMessage result;
+    result.set_value(message.value() * factor);
+    return result;
+  });
+
+  def_proto_fn(m, "make_test_message",
+               [](std::string text, double number) {
+                 TestMessage result;
+                 result.set_string_value(text);
+                 result.set_double_value(number);
+                 return result;
+               });
+
+  def_proto_fn(m, "get_value",
+               [](IntMessage message) { return message.value(); });
+
+  int32_t calls = 0;
+  def_proto_fn(m, "count_calls", [calls]() mutable { return ++calls; });
+
+  def_proto_fn(m, "check_positive", [](const IntMessage& message) {
+    if (message.value() <= 0) throw std::invalid_argument("not positive");
+  });
+
+  def_proto_fn(m, "full_name", [](const ::google::protobuf::Message& message) {
+    return message.GetDescriptor()->full_name();
+  });
+}
+
+}  // namespace
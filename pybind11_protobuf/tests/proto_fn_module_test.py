@@ -0,0 +1,64 @@
+# Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+#
+# All rights reserved. Use of this source code is governed by a
+# BSD-style license that can be found in the LICENSE file.
+"""Tests for def_proto_fn."""
+
+from absl.testing import absltest
+
+from pybind11_protobuf.tests import proto_fn_module as m
+from pybind11_protobuf.tests import test_pb2
+
+
+class ProtoFnTest(absltest.TestCase):
+
+  def test_function_pointer(self):
+    result = m.add_one(test_pb2.IntMessage(value=1))
+    self.assertIsInstance(result, test_pb2.IntMessage)
+    self.assertEqual(2, result.value)
+
+  def test_metadata(self):
+    self.assertEqual('add_one', m.add_one.__name__)
+    self.assertEqual('Returns message.value + 1.', m.add_one.__doc__)
+
+  def test_scalars(self):
+    self.assertEqual(6, m.scale(test_pb2.IntMessage(value=2), 3).value)
+    self.assertEqual(
+        test_pb2.TestMessage(string_value='a', double_value=1.5),
+        m.make_test_message('a', 1.5))
+
+  def test_by_value(self):
+    self.assertEqual(4, m.get_value(test_pb2.IntMessage(value=4)))
+
+  def test_mutable_functor(self):
+    self.assertEqual(1, m.count_calls())
+    self.assertEqual(2, m.count_calls())
+
+  def test_generic_message(self):
+    self.assertEqual('pybind11.test.TestMessage',
+                     m.full_name(test_pb2.TestMessage()))
+
+  def test_void(self):
+    self.assertIsNone(m.check_positive(test_pb2.IntMessage(value=1)))
+
+  def test_exception_translation(self):
+    with self.assertRaisesRegex(ValueError, 'not positive'):
+      m.check_positive(test_pb2.IntMessage(value=0))
+
+  def test_wrong_argument_count(self):
+    with self.assertRaisesRegex(TypeError, 'takes 2 positional arguments'):
+      m.scale(test_pb2.IntMessage())
+
+  def test_wrong_argument_type(self):
+    with self.assertRaisesRegex(TypeError, 'argument 1'):
+      m.scale(test_pb2.IntMessage(), 'x')
+    with self.assertRaisesRegex(TypeError, 'argument 0'):
+      m.add_one(test_pb2.TestMessage())
+
+  def test_keywords_unsupported(self):
+    with self.assertRaises(TypeError):
+      m.add_one(message=test_pb2.IntMessage())
+
+
+if __name__ == '__main__':
+  absltest.main()
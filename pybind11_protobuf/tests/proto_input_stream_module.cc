@@ -0,0 +1,51 @@
+// Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+//
+// All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include <pybind11/pybind11.h>
+
+#include <cstdint>
+#include <utility>
+
+#include "pybind11_protobuf/native_proto_caster.h"
+#include "pybind11_protobuf/proto_input_stream.h"
+#include "pybind11_protobuf/tests/test.pb.h"
+
+namespace py = ::pybind11;
+
+namespace {
+
+using ::pybind11::test::IntMessage;
+using ::pybind11_protobuf::ProtoInputStream;
+
+// Returns (sum of values, number of messages).
+std::pair<int64_t, int64_t> Sum(ProtoInputStream<IntMessage>& stream) {
+  int64_t sum = 0;
+  int64_t count = 0;
+  for (auto batch = stream.Next(); !batch.empty(); batch = stream.Next()) {
+    for (const IntMessage* message : batch) {
+      sum += message->value();
+      ++count;
+    }
+  }
+  return {sum, count};
+}
+
+PYBIND11_MODULE(proto_input_stream_module, m) {
+  pybind11_protobuf::ImportNativeProtoCasters();
+
+  m.def("sum", &Sum, py::arg("messages"));
+  m.def("sum_no_gil", &Sum, py::arg("messages"),
+        py::call_guard<py::gil_scoped_release>());
+
+  // Consumes only the first batch.
+  m.def(
+      "first_batch_size",
+      [](ProtoInputStream<IntMessage>* stream) {
+        return stream->Next().size();
+      },
+      py::arg("messages"));
+}
+
+}  // namespace
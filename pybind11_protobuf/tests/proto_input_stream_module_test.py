@@ -0,0 +1,70 @@
+# Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+#
+# All rights reserved. Use of this source code is governed by a
+# BSD-style license that can be found in the LICENSE file.
+"""Tests for the ProtoInputStream caster."""
+
+import threading
+
+from absl.testing import absltest
+from absl.testing import parameterized
+
+from pybind11_protobuf.tests import proto_input_stream_module as m
+from pybind11_protobuf.tests import test_pb2
+
+
+def int_messages(n):
+  for i in range(n):
+    yield test_pb2.IntMessage(value=i)
+
+
+class ProtoInputStreamTest(parameterized.TestCase):
+
+  @parameterized.named_parameters(('gil', m.sum), ('no_gil', m.sum_no_gil))
+  def test_generator(self, sum_fn):
+    self.assertEqual((sum(range(1000)), 1000), sum_fn(int_messages(1000)))
+
+  @parameterized.named_parameters(('gil', m.sum), ('no_gil', m.sum_no_gil))
+  def test_list(self, sum_fn):
+    self.assertEqual((3, 2), sum_fn(list(int_messages(3))))
+
+  def test_empty(self):
+    self.assertEqual((0, 0), m.sum([]))
+
+  def test_first_batch(self):
+    self.assertEqual(256, m.first_batch_size(int_messages(1000)))
+
+  def test_wrong_type(self):
+    with self.assertRaises(TypeError):
+      m.sum([test_pb2.IntMessage(value=1), test_pb2.TestMessage()])
+
+  def test_not_iterable(self):
+    with self.assertRaises(TypeError):
+      m.sum(test_pb2.IntMessage(value=1))
+    with self.assertRaises(TypeError):
+      m.sum(1)
+
+  @parameterized.named_parameters(('gil', m.sum), ('no_gil', m.sum_no_gil))
+  def test_generator_runs_on_calling_thread(self, sum_fn):
+    threads = set()
+
+    def recording():
+      for message in int_messages(1000):
+        threads.add(threading.get_ident())
+        yield message
+
+    self.assertEqual((sum(range(1000)), 1000), sum_fn(recording()))
+    self.assertEqual({threading.get_ident()}, threads)
+
+  def test_generator_error(self):
+
+    def failing():
+      yield test_pb2.IntMessage(value=1)
+      raise ValueError('generator failed')
+
+    with self.assertRaisesRegex(ValueError, 'generator failed'):
+      m.sum_no_gil(failing())
+
+
+if __name__ == '__main__':
+  absltest.main()
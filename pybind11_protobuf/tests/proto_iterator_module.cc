@@ -0,0 +1,96 @@
+// Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+//
+// All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include <pybind11/pybind11.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "pybind11_protobuf/native_proto_caster.h"
+#include "pybind11_protobuf/proto_iterator.h"
+#include "pybind11_protobuf/tests/test.pb.h"
+
+namespace py = ::pybind11;
+
+namespace {
+
+using ::pybind11::test::IntMessage;
+using ::pybind11_protobuf::MakeProtoIterator;
+using ::pybind11_protobuf::MakeProtoIteratorFromCallback;
+using ::pybind11_protobuf::ProtoIteratorOptions;
+using ::pybind11_protobuf::ProtoSink;
+
+// Number of count_forever producers stopped by their iterator.
+std::atomic<int> count_forever_cancellations{0};
+
+PYBIND11_MODULE(proto_iterator_module, m) {
+  pybind11_protobuf::ImportNativeProtoCasters();
+
+  m.def(
+      "count",
+      [](int32_t n, size_t chunk_size) {
+        auto next_value = std::make_shared<int32_t>(0);
+        ProtoIteratorOptions options;
+        options.chunk_size = chunk_size;
+        return MakeProtoIterator<IntMessage>(
+            [n, next_value]() -> absl::optional<IntMessage> {
+              if (*next_value >= n) return absl::nullopt;
+              IntMessage message;
+              message.set_value((*next_value)++);
+              return message;
+            },
+            options);
+      },
+      py::arg("n"), py::arg("chunk_size") = 64);
+
+  m.def(
+      "count_forever",
+      []() {
+        return MakeProtoIteratorFromCallback([](ProtoSink& sink) {
+          IntMessage message;
+          for (int32_t i = 0;; ++i) {
+            message.set_value(i);
+            if (!sink.Push(message)) {
+              ++count_forever_cancellations;
+              return;
+            }
+          }
+        });
+      });
+
+  m.def("count_forever_cancellations",
+        []() { return count_forever_cancellations.load(); });
+
+  m.def(
+      "fail_after",
+      [](int32_t n) {
+        return MakeProtoIteratorFromCallback([n](ProtoSink& sink) {
+          IntMessage message;
+          for (int32_t i = 0; i < n; ++i) {
+            message.set_value(i);
+            sink.Push(message);
+          }
+          throw std::runtime_error("producer failed");
+        });
+      },
+      py::arg("n"));
+
+  // Iterates over a vector owned by the returned iterator.
+  m.def("iterate_vector", [](int32_t n) {
+    auto messages = std::make_shared<std::vector<IntMessage>>(n);
+    for (int32_t i = 0; i < n; ++i) (*messages)[i].set_value(i);
+    return MakeProtoIteratorFromCallback([messages](ProtoSink& sink) {
+      for (const auto& message : *messages) {
+        if (!sink.Push(message)) return;
+      }
+    });
+  });
+}
+
+}  // namespace
@@ -0,0 +1,59 @@
+# Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+#
+# All rights reserved. Use of this source code is governed by a
+# BSD-style license that can be found in the LICENSE file.
+"""Tests for proto iterator bindings."""
+
+import itertools
+
+from absl.testing import absltest
+from absl.testing import parameterized
+
+from pybind11_protobuf.tests import proto_iterator_module as m
+from pybind11_protobuf.tests import test_pb2
+
+
+class ProtoIteratorTest(parameterized.TestCase):
+
+  @parameterized.parameters(1, 7, 64)
+  def test_count(self, chunk_size):
+    values = [x.value for x in m.count(1000, chunk_size=chunk_size)]
+    self.assertEqual(list(range(1000)), values)
+
+  def test_type(self):
+    self.assertIsInstance(next(m.count(1)), test_pb2.IntMessage)
+
+  def test_empty(self):
+    self.assertEmpty(list(m.count(0)))
+
+  def test_stop_early(self):
+    cancellations = m.count_forever_cancellations()
+    it = m.count_forever()
+    self.assertEqual([0, 1, 2],
+                     [x.value for x in itertools.islice(it, 3)])
+    # Destroying the iterator stops the producer, and joins it.
+    del it
+    self.assertEqual(cancellations + 1, m.count_forever_cancellations())
+
+  def test_producer_error(self):
+    it = m.fail_after(3)
+    self.assertEqual([0, 1, 2], [next(it).value for _ in range(3)])
+    with self.assertRaisesRegex(RuntimeError, 'producer failed'):
+      next(it)
+    # The error ends the stream.
+    for _ in range(2):
+      with self.assertRaises(StopIteration):
+        next(it)
+
+  def test_next_after_end(self):
+    it = m.count(2)
+    self.assertEqual([0, 1], [x.value for x in it])
+    with self.assertRaises(StopIteration):
+      next(it)
+
+  def test_iterate_vector(self):
+    self.assertEqual([0, 1, 2, 3], [x.value for x in m.iterate_vector(4)])
+
+
+if __name__ == '__main__':
+  absltest.main()
@@ -0,0 +1,62 @@
+// Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+//
+// All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include <pybind11/pybind11.h>
+
+#include <cstdint>
+#include <string>
+#include <variant>
+
+#include "pybind11_protobuf/native_proto_caster.h"
+#include "pybind11_protobuf/proto_overloads.h"
+#include "pybind11_protobuf/tests/test.pb.h"
+
+namespace py = ::pybind11;
+
+namespace {
+
+using ::pybind11::test::IntMessage;
+using ::pybind11::test::TestMessage;
+using ::pybind11_protobuf::DispatchProtoVariant;
+using ::pybind11_protobuf::ProtoOverloads;
+
+std::string HandleInt(const IntMessage& message) {
+  return "int:" + std::to_string(message.value());
+}
+
+std::string HandleTest(const TestMessage& message) {
+  return "test:" + message.string_value();
+}
+
+std::string HandleVariant(const std::variant<IntMessage, TestMessage>& v) {
+  if (const auto* message = std::get_if<IntMessage>(&v)) {
+    return HandleInt(*message);
+  }
+  return HandleTest(std::get<TestMessage>(v));
+}
+
+PYBIND11_MODULE(proto_overloads_module, m) {
+  pybind11_protobuf::ImportNativeProtoCasters();
+
+  m.def("handle", ProtoOverloads<std::string>()
+                      .Add<IntMessage>(&HandleInt)
+                      .Add<TestMessage>(&HandleTest));
+
+  m.def("handle_scaled",
+        ProtoOverloads<int32_t, int32_t>()
+            .Add<IntMessage>([](const IntMessage& message, int32_t factor) {
+              return message.value() * factor;
+            })
+            .Add<TestMessage>([](const TestMessage& message, int32_t factor) {
+              return message.int_value() * factor;
+            }),
+        py::arg("message"), py::arg("factor"));
+
+  m.def("handle_variant",
+        DispatchProtoVariant<std::variant<IntMessage, TestMessage>>(
+            &HandleVariant));
+}
+
+}  // namespace
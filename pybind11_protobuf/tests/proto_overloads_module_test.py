@@ -0,0 +1,51 @@
+# Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+#
+# All rights reserved. Use of this source code is governed by a
+# BSD-style license that can be found in the LICENSE file.
+"""Tests for descriptor-keyed proto overload dispatch."""
+
+from absl.testing import absltest
+from absl.testing import parameterized
+
+from pybind11_protobuf.tests import proto_overloads_module as m
+from pybind11_protobuf.tests import test_pb2
+
+
+class FakeDescriptor:
+  full_name = 'pybind11.test.IntMessage'
+
+
+class FakeIntMessage:
+  DESCRIPTOR = FakeDescriptor()
+
+  def SerializePartialToString(self):  # pylint: disable=invalid-name
+    return test_pb2.IntMessage(value=9).SerializeToString()
+
+
+class ProtoOverloadsTest(parameterized.TestCase):
+
+  @parameterized.parameters(m.handle, m.handle_variant)
+  def test_dispatch(self, handle):
+    # Repeated calls hit the per-class cache.
+    for _ in range(2):
+      self.assertEqual('int:3', handle(test_pb2.IntMessage(value=3)))
+      self.assertEqual('test:a', handle(test_pb2.TestMessage(string_value='a')))
+
+  def test_extra_arguments(self):
+    self.assertEqual(6, m.handle_scaled(test_pb2.IntMessage(value=2), 3))
+    self.assertEqual(
+        8, m.handle_scaled(test_pb2.TestMessage(int_value=4), factor=2))
+
+  def test_matching_full_name(self):
+    self.assertEqual('int:9', m.handle(FakeIntMessage()))
+
+  @parameterized.parameters(m.handle, m.handle_variant)
+  def test_unknown_type(self, handle):
+    with self.assertRaisesRegex(TypeError, 'Expected one of'):
+      handle(test_pb2.AnotherMessage())
+    with self.assertRaises(TypeError):
+      handle(1)
+
+
+if __name__ == '__main__':
+  absltest.main()
@@ -0,0 +1,62 @@
+// Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+//
+// All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include <pybind11/pybind11.h>
+
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "pybind11_protobuf/native_proto_caster.h"
+#include "pybind11_protobuf/proto_queue.h"
+#include "pybind11_protobuf/tests/test.pb.h"
+
+namespace py = ::pybind11;
+
+namespace {
+
+using ::pybind11::test::IntMessage;
+using ::pybind11::test::TestMessage;
+using ::pybind11_protobuf::ProtoQueue;
+
+PYBIND11_MODULE(proto_queue_module, m) {
+  pybind11_protobuf::ImportNativeProtoCasters();
+  pybind11_protobuf::DefineProtoQueue(m);
+
+  m.def("try_push", [](ProtoQueue& queue, const IntMessage& message) {
+    return queue.TryPush(message);
+  });
+
+  m.def("try_push_test_message",
+        [](ProtoQueue& queue, const TestMessage& message) {
+          return queue.TryPush(message);
+        });
+
+  // Starts num_threads threads, each pushing IntMessages with values
+  // thread * per_thread + [0, per_thread), and then closes the queue.
+  m.def(
+      "start_producers",
+      [](std::shared_ptr<ProtoQueue> queue, int32_t num_threads,
+         int32_t per_thread) {
+        std::thread([queue, num_threads, per_thread] {
+          std::vector<std::thread> threads;
+          for (int32_t t = 0; t < num_threads; ++t) {
+            threads.emplace_back([queue, t, per_thread] {
+              IntMessage message;
+              for (int32_t i = 0; i < per_thread; ++i) {
+                message.set_value(t * per_thread + i);
+                if (!queue->Push(message)) return;
+              }
+            });
+          }
+          for (auto& thread : threads) thread.join();
+          queue->Close();
+        }).detach();
+      },
+      py::arg("queue"), py::arg("num_threads"), py::arg("per_thread"));
+}
+
+}  // namespace
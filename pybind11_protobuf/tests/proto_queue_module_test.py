@@ -0,0 +1,81 @@
+# Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+#
+# All rights reserved. Use of this source code is governed by a
+# BSD-style license that can be found in the LICENSE file.
+"""Tests for the proto queue bindings."""
+
+from absl.testing import absltest
+
+from pybind11_protobuf.tests import proto_queue_module as m
+from pybind11_protobuf.tests import test_pb2
+
+
+class ProtoQueueTest(absltest.TestCase):
+
+  def test_drain_in_order(self):
+    queue = m.ProtoQueue(capacity=10)
+    for i in range(3):
+      self.assertTrue(m.try_push(queue, test_pb2.IntMessage(value=i)))
+    self.assertLen(queue, 3)
+    drained = queue.drain(timeout=0)
+    self.assertEqual([0, 1, 2], [x.value for x in drained])
+    self.assertIsInstance(drained[0], test_pb2.IntMessage)
+    self.assertEmpty(queue)
+
+  def test_max_items(self):
+    queue = m.ProtoQueue(capacity=10)
+    for i in range(5):
+      m.try_push(queue, test_pb2.IntMessage(value=i))
+    self.assertEqual([0, 1], [x.value for x in queue.drain(max_items=2)])
+    m.try_push(queue, test_pb2.IntMessage(value=5))
+    self.assertEqual([2, 3, 4, 5], [x.value for x in queue.drain(timeout=0)])
+
+  def test_mixed_types(self):
+    queue = m.ProtoQueue(capacity=10)
+    m.try_push(queue, test_pb2.IntMessage(value=1))
+    m.try_push_test_message(queue, test_pb2.TestMessage(string_value='a'))
+    first, second = queue.drain(timeout=0)
+    self.assertEqual(test_pb2.IntMessage(value=1), first)
+    self.assertEqual(test_pb2.TestMessage(string_value='a'), second)
+
+  def test_full(self):
+    queue = m.ProtoQueue(capacity=2)
+    self.assertEqual(2, queue.capacity)
+    self.assertTrue(m.try_push(queue, test_pb2.IntMessage(value=0)))
+    self.assertTrue(m.try_push(queue, test_pb2.IntMessage(value=1)))
+    self.assertFalse(m.try_push(queue, test_pb2.IntMessage(value=2)))
+    queue.drain(max_items=1)
+    self.assertTrue(m.try_push(queue, test_pb2.IntMessage(value=2)))
+
+  def test_timeout(self):
+    queue = m.ProtoQueue(capacity=1)
+    self.assertEmpty(queue.drain(timeout=0.01))
+
+  def test_closed(self):
+    queue = m.ProtoQueue(capacity=1)
+    queue.close()
+    self.assertTrue(queue.closed)
+    self.assertFalse(m.try_push(queue, test_pb2.IntMessage(value=0)))
+    # Does not wait once closed.
+    self.assertEmpty(queue.drain())
+
+  def test_producer_threads(self):
+    # The small capacity makes producers wait for the consumer.
+    queue = m.ProtoQueue(capacity=16)
+    m.start_producers(queue, num_threads=4, per_thread=1000)
+    values = []
+    while True:
+      batch = queue.drain(max_items=100)
+      if not batch:
+        break
+      values.extend(x.value for x in batch)
+    self.assertTrue(queue.closed)
+    self.assertCountEqual(range(4000), values)
+    # Each producer's messages arrive in order.
+    for t in range(4):
+      own = [v for v in values if v // 1000 == t]
+      self.assertEqual(sorted(own), own)
+
+
+if __name__ == '__main__':
+  absltest.main()
@@ -0,0 +1,144 @@
+// Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+//
+// All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "absl/strings/ascii.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/descriptor.pb.h"
+#include "google/protobuf/dynamic_message.h"
+#include "google/protobuf/text_format.h"
+#include "pybind11_protobuf/native_proto_caster.h"
+#include "pybind11_protobuf/return_fields.h"
+#include "pybind11_protobuf/tests/test.pb.h"
+
+namespace py = ::pybind11;
+
+namespace {
+
+using ::google::protobuf::Descriptor;
+using ::google::protobuf::DescriptorProto;
+using ::google::protobuf::FieldDescriptorProto;
+using ::google::protobuf::Message;
+using ::pybind11::test::TestMessage;
+using ::pybind11_protobuf::WithReturnFields;
+using ::pybind11_protobuf::impl::ProtoFieldProjection;
+
+TestMessage MakeTestMessage(int size) {
+  TestMessage message;
+  message.set_string_value(std::string(size, 'x'));
+  message.set_int_value(size);
+  message.mutable_int_message()->set_value(1);
+  for (int i = 0; i < 3; ++i) {
+    auto* item = message.add_repeated_int_message();
+    item->set_value(i);
+    message.add_repeated_int_value(i);
+  }
+  (*message.mutable_string_int_map())["a"] = 1;
+  message.mutable_nested()->set_value(2);
+  return message;
+}
+
+const TestMessage& GetStatic() {
+  static const TestMessage* message = new TestMessage(MakeTestMessage(4));
+  return *message;
+}
+
+void AddField(DescriptorProto* message, const char* name, int number,
+              FieldDescriptorProto::Type type) {
+  auto* field = message->add_field();
+  field->set_name(name);
+  field->set_number(number);
+  field->set_label(FieldDescriptorProto::LABEL_OPTIONAL);
+  field->set_type(type);
+}
+
+// Builds a proto2 message with a group, which test.proto cannot declare:
+//
+// message GroupMessage {
+//   optional group Item = 1 {
+//     optional int32 a = 2;
+//     optional int32 b = 3;
+//   }
+//   optional int32 c = 4;
+// }
+const Descriptor* GetGroupMessageDescriptor() {
+  static const Descriptor* descriptor = [] {
+    ::google::protobuf::FileDescriptorProto file;
+    file.set_name("pybind11_protobuf/tests/return_fields_group.proto");
+    file.set_package("pybind11.test");
+    file.set_syntax("proto2");
+    DescriptorProto* message = file.add_message_type();
+    message->set_name("GroupMessage");
+    DescriptorProto* item = message->add_nested_type();
+    item->set_name("Item");
+    AddField(item, "a", 2, FieldDescriptorProto::TYPE_INT32);
+    AddField(item, "b", 3, FieldDescriptorProto::TYPE_INT32);
+    AddField(message, "item", 1, FieldDescriptorProto::TYPE_GROUP);
+    message->mutable_field(0)->set_type_name(
+        ".pybind11.test.GroupMessage.Item");
+    AddField(message, "c", 4, FieldDescriptorProto::TYPE_INT32);
+    auto* pool = new ::google::protobuf::DescriptorPool();
+    return pool->BuildFile(file)->message_type(0);
+  }();
+  return descriptor;
+}
+
+// Projects GroupMessage{item{a: 1, b: 2}, c: 3} onto paths, and returns the
+// parsed result in text format.
+std::string ProjectGroupMessage(const std::vector<std::string>& paths) {
+  static auto* factory = new ::google::protobuf::DynamicMessageFactory();
+  const Descriptor* descriptor = GetGroupMessageDescriptor();
+  std::unique_ptr<Message> message(factory->GetPrototype(descriptor)->New());
+  const auto* reflection = message->GetReflection();
+  Message* item = reflection->MutableMessage(
+      message.get(), descriptor->FindFieldByName("item"));
+  const Descriptor* item_descriptor = item->GetDescriptor();
+  item->GetReflection()->SetInt32(item, item_descriptor->FindFieldByName("a"),
+                                  1);
+  item->GetReflection()->SetInt32(item, item_descriptor->FindFieldByName("b"),
+                                  2);
+  reflection->SetInt32(message.get(), descriptor->FindFieldByName("c"), 3);
+
+  message->ByteSizeLong();
+  std::string serialized;
+  ProtoFieldProjection::Create(descriptor, paths)
+      ->Serialize(*message, &serialized);
+  std::unique_ptr<Message> projected(message->New());
+  if (!projected->ParsePartialFromString(serialized)) {
+    throw std::runtime_error("Failed to parse the projected message");
+  }
+  ::google::protobuf::TextFormat::Printer printer;
+  printer.SetSingleLineMode(true);
+  std::string text;
+  printer.PrintToString(*projected, &text);
+  return std::string(absl::StripAsciiWhitespace(text));
+}
+
+PYBIND11_MODULE(return_fields_module, m) {
+  pybind11_protobuf::ImportNativeProtoCasters();
+
+  m.def("make", &MakeTestMessage);
+  m.def("make_int_only", WithReturnFields(&MakeTestMessage, {"int_value"}));
+  m.def("make_projected",
+        WithReturnFields([](int size) { return MakeTestMessage(size); },
+                         {"int_value", "repeated_int_message.value",
+                          "string_int_map", "nested"}));
+  m.def("static_projected",
+        WithReturnFields(&GetStatic, {"int_message.value", "int_message"}),
+        py::call_guard<py::gil_scoped_release>());
+  m.def("project_group_message", &ProjectGroupMessage, py::arg("paths"));
+  m.def("invalid_path", []() {
+    WithReturnFields(&MakeTestMessage, {"int_value.value"});
+  });
+}
+
+}  // namespace
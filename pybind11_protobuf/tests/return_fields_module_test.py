@@ -0,0 +1,46 @@
+# Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+#
+# All rights reserved. Use of this source code is governed by a
+# BSD-style license that can be found in the LICENSE file.
+"""Tests for WithReturnFields."""
+
+from absl.testing import absltest
+
+from pybind11_protobuf.tests import return_fields_module as m
+from pybind11_protobuf.tests import test_pb2
+
+
+class ReturnFieldsTest(absltest.TestCase):
+
+  def test_single_field(self):
+    message = m.make_int_only(5)
+    self.assertIsInstance(message, test_pb2.TestMessage)
+    self.assertEqual(test_pb2.TestMessage(int_value=5), message)
+
+  def test_nested_fields(self):
+    message = m.make_projected(5)
+    expected = m.make(5)
+    expected.ClearField('string_value')
+    expected.ClearField('int_message')
+    expected.ClearField('repeated_int_value')
+    self.assertEqual(expected, message)
+
+  def test_whole_field_wins(self):
+    message = m.static_projected()
+    self.assertEqual(
+        test_pb2.TestMessage(int_message=test_pb2.IntMessage(value=1)),
+        message)
+
+  def test_group_field(self):
+    self.assertEqual('Item { a: 1 }', m.project_group_message(['item.a']))
+    self.assertEqual('Item { a: 1 } c: 3',
+                     m.project_group_message(['item.a', 'c']))
+    self.assertEqual('Item { a: 1 b: 2 }', m.project_group_message(['item']))
+
+  def test_invalid_path(self):
+    with self.assertRaises(ValueError):
+      m.invalid_path()
+
+
+if __name__ == '__main__':
+  absltest.main()
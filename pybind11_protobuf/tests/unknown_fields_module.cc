@@ -0,0 +1,102 @@
+// Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+//
+// All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include <pybind11/pybind11.h>
+
+#include <cstdint>
+
+#include "google/protobuf/message.h"
+#include "pybind11_protobuf/check_unknown_fields.h"
+#include "pybind11_protobuf/native_proto_caster.h"
+#include "pybind11_protobuf/proto_input_stream.h"
+#include "pybind11_protobuf/tests/extension.pb.h"
+#include "pybind11_protobuf/tests/test.pb.h"
+
+namespace py = ::pybind11;
+
+namespace {
+
+using pybind11::test::BaseMessage;
+
+// Returns the number of unknown fields of the message, as parsed in C++.
+template <typename ProtoType>
+void DefUnknownFieldCount(py::module_& m, const char* py_name) {
+  m.def(
+      py_name,
+      [](const ProtoType& message) {
+        return message.GetReflection()->GetUnknownFields(message).field_count();
+      },
+      py::arg("message"));
+}
+
+PYBIND11_MODULE(unknown_fields_module, m) {
+  pybind11_protobuf::ImportNativeProtoCasters();
+  // As if the binary linked :disallow_extensions_with_unknown_fields.
+  pybind11_protobuf::check_unknown_fields::ExtensionsWithUnknownFieldsPolicy::
+      StrongSetDisallow();
+  pybind11_protobuf::DefineUnknownFieldCheckCounters(m);
+
+  m.def(
+      "set_sampled",
+      [](uint32_t sample_period, uint32_t backoff_after,
+         uint32_t max_sample_period, bool raise_on_violation) {
+        pybind11_protobuf::check_unknown_fields::SamplingOptions options;
+        options.sample_period = sample_period;
+        options.backoff_after = backoff_after;
+        options.max_sample_period = max_sample_period;
+        options.raise_on_violation = raise_on_violation;
+        pybind11_protobuf::check_unknown_fields::
+            ExtensionsWithUnknownFieldsPolicy::SetSampled(options);
+      },
+      py::arg("sample_period") = 1, py::arg("backoff_after") = 0,
+      py::arg("max_sample_period") = 1, py::arg("raise_on_violation") = true);
+
+  m.def(
+      "get_int_message_value",
+      [](const BaseMessage& message) {
+        return message.GetExtension(pybind11::test::int_message).value();
+      },
+      py::arg("message"));
+
+  DefUnknownFieldCount<BaseMessage>(m, "base_message_unknown_fields");
+  DefUnknownFieldCount<pybind11::test::NestLevel1>(
+      m, "nest_level1_unknown_fields");
+  DefUnknownFieldCount<pybind11::test::NestLevel2>(
+      m, "nest_level2_unknown_fields");
+  DefUnknownFieldCount<pybind11::test::AllowUnknownInner>(
+      m, "allow_unknown_inner_unknown_fields");
+  DefUnknownFieldCount<pybind11::test::IntMessage>(
+      m, "int_message_unknown_fields");
+
+  pybind11_protobuf::AllowUnknownFieldsFor("pybind11.test.AllowUnknownOuter",
+                                           "inner");
+  m.def(
+      "allow_unknown_outer_unknown_fields",
+      [](const pybind11::test::AllowUnknownOuter& message) {
+        return message.inner()
+            .GetReflection()
+            ->GetUnknownFields(message.inner())
+            .field_count();
+      },
+      py::arg("message"));
+
+  m.def(
+      "base_message_stream_unknown_fields",
+      [](pybind11_protobuf::ProtoInputStream<BaseMessage>& stream) {
+        int count = 0;
+        for (auto batch = stream.Next(); !batch.empty();
+             batch = stream.Next()) {
+          for (const BaseMessage* message : batch) {
+            count += message->GetReflection()
+                         ->GetUnknownFields(*message)
+                         .field_count();
+          }
+        }
+        return count;
+      },
+      py::arg("stream"));
+}
+
+}  // namespace
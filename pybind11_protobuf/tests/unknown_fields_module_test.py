@@ -0,0 +1,132 @@
+# Copyright (c) 2021 The Pybind Development Team. All rights reserved.
+#
+# All rights reserved. Use of this source code is governed by a
+# BSD-style license that can be found in the LICENSE file.
+"""Tests for the unknown field check when parsing into generated types."""
+
+from absl.testing import absltest
+
+from pybind11_protobuf.tests import extension_in_other_file_pb2
+from pybind11_protobuf.tests import extension_pb2
+from pybind11_protobuf.tests import test_pb2
+from pybind11_protobuf.tests import unknown_fields_module as m
+
+
+def get_base_message(in_other_file_value=None):
+  msg = extension_pb2.BaseMessage()
+  if in_other_file_value is None:
+    msg.Extensions[extension_pb2.int_message].value = 5
+  else:
+    msg.Extensions[extension_in_other_file_pb2.MessageInOtherFile
+                   .message_in_other_file_extension].value = in_other_file_value
+  return msg
+
+
+class UnknownFieldsTest(absltest.TestCase):
+
+  def tearDown(self):
+    super().tearDown()
+    m.set_sampled()
+
+  def test_extension_linked_in_cpp(self):
+    self.assertEqual(m.get_int_message_value(get_base_message()), 5)
+
+  def test_extension_only_known_to_python(self):
+    with self.assertRaisesRegex(
+        ValueError,
+        'Proto Message of type pybind11.test.BaseMessage has an Unknown Field'
+        r': 1003 \(.*extension\.proto\)'):
+      m.base_message_unknown_fields(get_base_message(in_other_file_value=7))
+
+  def test_nested_extension_only_known_to_python(self):
+    msg = extension_pb2.NestLevel2()
+    msg.nest_lvl1.base_msg.CopyFrom(get_base_message(in_other_file_value=7))
+    with self.assertRaisesRegex(
+        ValueError,
+        'with parent of type pybind11.test.BaseMessage: '
+        r'nest_lvl1\.base_msg\.1003 .*'
+        r'AllowUnknownFieldsFor\("pybind11.test.NestLevel2", '
+        r'"nest_lvl1.base_msg"\)'):
+      m.nest_level2_unknown_fields(msg)
+
+  def test_input_stream_extension_only_known_to_python(self):
+    messages = [get_base_message(), get_base_message(in_other_file_value=7)]
+    with self.assertRaisesRegex(ValueError, r'Unknown Field: 1003'):
+      m.base_message_stream_unknown_fields(iter(messages))
+
+  def test_unknown_field_not_known_to_python(self):
+    inner = extension_pb2.AllowUnknownInner()
+    inner.Extensions[
+        extension_in_other_file_pb2.AllowUnknownInnerExtension.hook].value = 3
+    # Field 2001 of AllowUnknownInner is no extension of BaseMessage.
+    msg = extension_pb2.BaseMessage.FromString(inner.SerializeToString())
+    self.assertEqual(m.base_message_unknown_fields(msg), 1)
+
+  def test_allowed_unknown_field(self):
+    msg = extension_pb2.AllowUnknownOuter()
+    msg.inner.Extensions[
+        extension_in_other_file_pb2.AllowUnknownInnerExtension.hook].value = 3
+    self.assertEqual(m.allow_unknown_outer_unknown_fields(msg), 1)
+    with self.assertRaisesRegex(ValueError, 'AllowUnknownInner'):
+      m.allow_unknown_inner_unknown_fields(msg.inner)
+
+  # The sampling state is kept per type, and set_sampled restarts it.
+
+  def test_sampled_period(self):
+    m.set_sampled(sample_period=3)
+    before = m.unknown_field_check_counters()
+    for _ in range(6):
+      m.int_message_unknown_fields(test_pb2.IntMessage(value=1))
+    after = m.unknown_field_check_counters()
+    # Conversions 1 and 4.
+    self.assertEqual(after['checks'] - before['checks'], 2)
+    self.assertEqual(after['violations'], before['violations'])
+
+  def test_sampled_backoff(self):
+    m.set_sampled(sample_period=1, backoff_after=2, max_sample_period=4)
+    before = m.unknown_field_check_counters()
+    msg = extension_pb2.NestLevel1()
+    msg.base_msg.Extensions[extension_pb2.int_message].value = 5
+    for _ in range(8):
+      m.nest_level1_unknown_fields(msg)
+    after = m.unknown_field_check_counters()
+    # Conversions 1, 2 (period 1), 3, 5 (period 2) and 7 (period 4).
+    self.assertEqual(after['checks'] - before['checks'], 5)
+
+  def test_sampled_backoff_saturates(self):
+    m.set_sampled(
+        sample_period=2**31, backoff_after=1, max_sample_period=2**32 - 1)
+    before = m.unknown_field_check_counters()
+    msg = extension_pb2.AllowUnknownOuter()
+    for _ in range(2):
+      m.allow_unknown_outer_unknown_fields(msg)
+    after = m.unknown_field_check_counters()
+    # Doubling the period of 2**31 must not wrap to 0, which checks every
+    # conversion.
+    self.assertEqual(after['checks'] - before['checks'], 1)
+
+  def test_set_sampled_restarts_sampling(self):
+    msg = test_pb2.IntMessage(value=1)
+    m.set_sampled(sample_period=4)
+    before = m.unknown_field_check_counters()
+    for _ in range(2):
+      m.int_message_unknown_fields(msg)
+    m.set_sampled(sample_period=4)
+    m.int_message_unknown_fields(msg)
+    after = m.unknown_field_check_counters()
+    # Conversion 1, and the first conversion with the new options.
+    self.assertEqual(after['checks'] - before['checks'], 2)
+
+  def test_sampled_violation_counted(self):
+    m.set_sampled(raise_on_violation=False)
+    before = m.unknown_field_check_counters()
+    self.assertEqual(
+        m.base_message_unknown_fields(get_base_message(in_other_file_value=7)),
+        1)
+    after = m.unknown_field_check_counters()
+    self.assertEqual(after['checks'] - before['checks'], 1)
+    self.assertEqual(after['violations'] - before['violations'], 1)
+
+
+if __name__ == '__main__':
+  absltest.main()
@@ -5,6 +5,7 @@
 
 from absl.testing import absltest
 
+from pybind11_protobuf.tests import pass_by_module
 from pybind11_protobuf.tests import pass_proto2_message_module
 from pybind11_protobuf.tests import test_pb2
 
@@ -23,6 +24,12 @@ class MessageTest(absltest.TestCase):
     )
     self.assertGreater(space_used_estimate, msg_size)
 
+  def test_greater_than_2gb_limit_to_python(self):
+    # Serializing the message to convert it would overflow its cached sizes.
+    kb = 1024
+    with self.assertRaisesRegex(ValueError, 'exceeds the 2GB limit'):
+      pass_by_module.make_large_message(2 * kb**3 + kb)
+
 
 if __name__ == '__main__':
   absltest.main()
@@ -6,14 +6,19 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
+#include <array>
 #include <cstdint>
+#include <map>
+#include <string>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/functional/function_ref.h"
 #include "absl/status/statusor.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "google/protobuf/dynamic_message.h"
 #include "pybind11_protobuf/tests/test.pb.h"
 #include "pybind11_protobuf/wrapped_proto_caster.h"
@@ -149,6 +154,51 @@ PYBIND11_MODULE(wrapped_proto_module, m) {
           return result;
         }),
         py::arg("value") = 123);
+
+  // Other containers of protos.
+  m.def("check_int_message_span",
+        WithWrappedProtos([](absl::Span<const IntMessage> v, int32_t value) {
+          int i = 0;
+          for (const auto& x : v) {
+            i += CheckMessage(&x, value);
+          }
+          return i;
+        }),
+        py::arg("protos"), py::arg("value"));
+  m.def("check_int_message_array",
+        WithWrappedProtos(
+            [](const std::array<IntMessage, 2>& v, int32_t value) {
+              int i = 0;
+              for (const auto& x : v) {
+                i += CheckMessage(&x, value);
+              }
+              return i;
+            }),
+        py::arg("protos"), py::arg("value"));
+  m.def("make_int_message_array", WithWrappedProtos([](int value) {
+          std::array<IntMessage, 2> result;
+          for (auto& x : result) {
+            x.set_value(value);
+          }
+          return result;
+        }),
+        py::arg("value") = 123);
+  m.def("sum_int_message_map",
+        WithWrappedProtos([](const std::map<int, IntMessage>& v) {
+          int sum = 0;
+          for (const auto& kv : v) {
+            sum += kv.first * kv.second.value();
+          }
+          return sum;
+        }),
+        py::arg("protos"));
+  m.def("make_int_message_map", WithWrappedProtos([](int value) {
+          absl::flat_hash_map<std::string, IntMessage> result;
+          result["a"].set_value(value);
+          result["b"].set_value(value + 1);
+          return result;
+        }),
+        py::arg("value") = 123);
 }
 
 /// Below here are compile tests for fast_cpp_proto_casters
@@ -162,6 +212,10 @@ TestMessage&& GetRValue() { return std::move(kMessage); }
 absl::StatusOr<TestMessage> GetStatusOr() { return TestMessage(); }
 absl::optional<TestMessage> GetOptional() { return TestMessage(); }
 std::vector<TestMessage> GetVector() { return {}; }
+absl::Span<const TestMessage> GetSpan() { return {}; }
+std::array<TestMessage, 1> GetArray() { return {}; }
+std::map<int, TestMessage> GetMap() { return {}; }
+absl::flat_hash_map<std::string, TestMessage> GetHashMap() { return {}; }
 
 void PassInt(int) {}
 void PassConstReference(const TestMessage&) {}
@@ -170,6 +224,10 @@ void PassValue(TestMessage) {}
 void PassRValue(TestMessage&&) {}
 void PassOptional(absl::optional<TestMessage>) {}
 void PassVector(std::vector<TestMessage>) {}
+void PassSpan(absl::Span<const TestMessage>) {}
+void PassArray(const std::array<TestMessage, 1>&) {}
+void PassMap(const std::map<int, TestMessage>&) {}
+void PassHashMap(absl::flat_hash_map<std::string, TestMessage>) {}
 
 struct Struct {
   TestMessage MemberFn() { return kMessage; }
@@ -215,6 +273,11 @@ void test_static_asserts() {
   absl::FunctionRef<absl::optional<TestMessage>()>(
       WithWrappedProtos(GetOptional));
   absl::FunctionRef<std::vector<TestMessage>()>(WithWrappedProtos(GetVector));
+  absl::FunctionRef<absl::Span<const TestMessage>()>(WithWrappedProtos(GetSpan));
+  absl::FunctionRef<std::array<TestMessage, 1>()>(WithWrappedProtos(GetArray));
+  absl::FunctionRef<std::map<int, TestMessage>()>(WithWrappedProtos(GetMap));
+  absl::FunctionRef<absl::flat_hash_map<std::string, TestMessage>()>(
+      WithWrappedProtos(GetHashMap));
 
   // Passing types
   absl::FunctionRef<void(int)>(WithWrappedProtos(PassInt));
@@ -227,6 +290,14 @@ void test_static_asserts() {
       WithWrappedProtos(PassOptional));
   absl::FunctionRef<void(std::vector<TestMessage>)>(
       WithWrappedProtos(PassVector));
+  absl::FunctionRef<void(absl::Span<const TestMessage>)>(
+      WithWrappedProtos(PassSpan));
+  absl::FunctionRef<void(const std::array<TestMessage, 1>&)>(
+      WithWrappedProtos(PassArray));
+  absl::FunctionRef<void(const std::map<int, TestMessage>&)>(
+      WithWrappedProtos(PassMap));
+  absl::FunctionRef<void(absl::flat_hash_map<std::string, TestMessage>)>(
+      WithWrappedProtos(PassHashMap));
 }
 
 #if defined(WRAPPED_PROTO_CASTER_NONCOMPILE_TEST)
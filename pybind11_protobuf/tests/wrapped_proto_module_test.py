@@ -75,10 +75,40 @@ class WrappedProtoTest(parameterized.TestCase, compare.ProtoAssertions):
     self.assertEqual(2, m.check_int_message_list(a, 34))
     self.assertEqual(2, m.check_int_message_list(a, 33))
 
+  def test_check_list_with_none(self):
+    with self.assertRaises(TypeError):
+      m.check_int_message_list([test_pb2.IntMessage(value=34), None], 34)
+
+  def test_check_val_with_none(self):
+    with self.assertRaises(TypeError):
+      m.check_val(None, 32)
+
   def test_make_list(self):
     a = m.make_int_message_list(44)
     self.assertEqual(3, m.take_int_message_list(a, 44))
 
+  def test_check_span(self):
+    a = [m.make_int_message(value=33), test_pb2.IntMessage(value=34)]
+    self.assertEqual(1, m.check_int_message_span(a, 34))
+    self.assertEqual(0, m.check_int_message_span([], 34))
+
+  def test_array(self):
+    a = m.make_int_message_array(45)
+    self.assertLen(a, 2)
+    self.assertEqual(2, m.check_int_message_array(a, 45))
+    with self.assertRaises(TypeError):
+      m.check_int_message_array(a[:1], 45)
+
+  def test_map(self):
+    self.assertEqual(
+        7,
+        m.sum_int_message_map({
+            1: test_pb2.IntMessage(value=3),
+            2: m.make_int_message(value=2),
+        }))
+    a = m.make_int_message_map(5)
+    self.assertEqual({'a': 5, 'b': 6}, {k: v.value for k, v in a.items()})
+
   def test_call_with_str(self):
     with self.assertRaises(TypeError):
       m.check('any string', 32)
@@ -7,12 +7,18 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/pytypes.h>
 
+#include <array>
+#include <cstddef>
+#include <map>
 #include <memory>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/status/statusor.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "google/protobuf/message.h"
 #include "pybind11_protobuf/proto_cast_util.h"
 #include "pybind11_protobuf/proto_caster_impl.h"
@@ -136,9 +142,21 @@ struct wrapped_proto_caster : public pybind11_protobuf::proto_caster_load_impl<
   using Base::value;
   using pybind11_protobuf::native_cast_impl::cast_impl;
 
+  // WrappedProto<T, kValue> is loaded in place into storage, and then moved
+  // into the wrapper, which avoids a separate heap allocation.
+  using Storage = std::conditional_t<WrappedProtoType::kind ==
+                                         WrappedProtoKind::kValue,
+                                     absl::optional<ProtoType>, std::nullptr_t>;
+  Storage storage;
+
  public:
   static constexpr auto name = pybind11::detail::const_name<WrappedProtoType>();
 
+  // load converts from Python -> C++
+  bool load(pybind11::handle src, bool convert) {
+    return this->template load_impl<WrappedProtoType::kind>(src, convert);
+  }
+
   // cast converts from C++ -> Python
   static pybind11::handle cast(WrappedProtoType src,
                                pybind11::return_value_policy policy,
@@ -163,17 +181,36 @@ struct wrapped_proto_caster : public pybind11_protobuf::proto_caster_load_impl<
         /*is_const*/ WrappedProtoKind::kConst == WrappedProtoType::kind);
   }
 
+  template <WrappedProtoKind K>
+  typename std::enable_if<(K == WrappedProtoKind::kValue), bool>::type
+  load_impl(pybind11::handle src, bool convert) {
+    if (src.is_none()) {
+      value = nullptr;
+      return true;
+    }
+    storage.emplace();
+    if (!Base::load_into(src, convert, &*storage)) {
+      storage.reset();
+      return false;
+    }
+    value = &*storage;
+    return true;
+  }
+
+  template <WrappedProtoKind K>
+  typename std::enable_if<(K != WrappedProtoKind::kValue), bool>::type
+  load_impl(pybind11::handle src, bool convert) {
+    return Base::load(src, convert);
+  }
+
   // PYBIND11_TYPE_CASTER
   template <WrappedProtoKind K>
   typename std::enable_if<(K == WrappedProtoKind::kValue),
                           WrappedProtoType>::type
   convert() {
-    // WrappedProto<T, kValue> ALWAYS creates a copy.
-    if (owned) {
-      return std::move(*owned);
-    } else {
-      return ProtoType(*value);
-    }
+    // WrappedProto<T, kValue> ALWAYS creates a copy, which was made by load.
+    if (!value) throw pybind11::reference_cast_error();
+    return std::move(*storage);
   }
 
   template <WrappedProtoKind K>
@@ -216,7 +253,8 @@ struct wrapped_proto_caster : public pybind11_protobuf::proto_caster_load_impl<
 /// and make_type_caster<> selection.  WrapHelper applies the rewrite to the
 /// functions.
 ///
-/// NOTE: This always copies values, similar to WrappedProto<Kind, kValue>.
+/// NOTE: This always copies values, similar to WrappedProto<Kind, kValue>,
+/// but each element is loaded directly into the vector.
 
 /// WrappedProtoVector<T> wraps a std::vector<T>. It is used to add std::vector
 /// support for WithWrappedProtos by forwarding the internal T to the native
@@ -237,6 +275,39 @@ struct WrappedProtoVector {
   operator std::vector<ProtoType>&&() && noexcept { return std::move(protos); }
 };
 
+// Converts a range of protos to a Python list. The protos are moved from when
+// the range is mutable, and copied otherwise.
+template <typename Range>
+pybind11::handle wrapped_proto_list_cast(Range&& protos,
+                                         pybind11::handle parent) {
+  pybind11::list l(protos.size());
+  Py_ssize_t index = 0;
+  for (auto&& value : protos) {
+    constexpr bool kIsConst =
+        std::is_const<std::remove_reference_t<decltype(value)>>::value;
+    auto value_ = pybind11::reinterpret_steal<pybind11::object>(
+        pybind11_protobuf::native_cast_impl::cast_impl(
+            const_cast<std::remove_const_t<
+                std::remove_reference_t<decltype(value)>>*>(&value),
+            kIsConst ? pybind11::return_value_policy::copy
+                     : pybind11::return_value_policy::move,
+            parent, kIsConst));
+    if (!value_) {
+      return pybind11::handle();
+    }
+    PyList_SET_ITEM(l.ptr(), index++,
+                    value_.release().ptr());  // steals a reference
+  }
+  return l.release();
+}
+
+// Returns whether src is a sequence which may hold protos.
+inline bool IsProtoSequence(pybind11::handle src) {
+  return pybind11::isinstance<pybind11::sequence>(src) &&
+         !pybind11::isinstance<pybind11::bytes>(src) &&
+         !pybind11::isinstance<pybind11::str>(src);
+}
+
 // type_caster<> implementation for WrappedProtoVector. See
 // pybind11::list_caster.
 template <typename ProtoType>
@@ -250,24 +321,18 @@ struct wrapped_proto_vector_caster {
   bool load(pybind11::handle src, bool convert) {
     using load_impl = pybind11_protobuf::proto_caster_load_impl<ProtoType>;
 
-    if (!pybind11::isinstance<pybind11::sequence>(src) ||
-        pybind11::isinstance<pybind11::bytes>(src) ||
-        pybind11::isinstance<pybind11::str>(src)) {
+    if (!IsProtoSequence(src)) {
       return false;
     }
     auto s = pybind11::reinterpret_borrow<pybind11::sequence>(src);
     value.protos.clear();
     value.protos.reserve(s.size());
     for (auto it : s) {
-      load_impl conv;
-      if (!conv.load(it, convert)) {
+      // Parse each element in place.
+      value.protos.emplace_back();
+      if (!load_impl::load_into(it, convert, &value.protos.back())) {
         return false;
       }
-      if (conv.owned) {
-        value.protos.emplace_back(std::move(*conv.owned));
-      } else {
-        value.protos.emplace_back(*conv.value);
-      }
     }
     return true;
   }
@@ -276,30 +341,232 @@ struct wrapped_proto_vector_caster {
   static pybind11::handle cast(WrappedProtoVector<ProtoType> src,
                                pybind11::return_value_policy policy,
                                pybind11::handle parent) {
-    pybind11::list l(src.protos.size());
-    Py_ssize_t index = 0;
-    for (auto&& value : src.protos) {
+    return wrapped_proto_list_cast(src.protos, parent);
+  }
+
+  explicit operator WrappedProtoVector<ProtoType>&&() && {
+    return std::move(value);
+  }
+
+  template <typename T_>
+  using cast_op_type = WrappedProtoVector<ProtoType>&&;
+
+  WrappedProtoVector<ProtoType> value;
+};
+
+/// WrappedProtoSpan<T> stands in for absl::Span<const T>. When loaded from
+/// Python, the elements are loaded into storage owned by the wrapper, and the
+/// span borrows from it for the duration of the call. When returned from C++,
+/// the span is copied to a Python list.
+template <typename ProtoType>
+struct WrappedProtoSpan {
+  std::vector<ProtoType> storage;
+  absl::Span<const ProtoType> protos;
+
+  WrappedProtoSpan() = default;
+
+  // Moving a std::vector keeps its buffer, so protos stays valid. Copying
+  // would not, so this is move-only.
+  WrappedProtoSpan(WrappedProtoSpan&&) = default;
+  WrappedProtoSpan& operator=(WrappedProtoSpan&&) = default;
+
+  WrappedProtoSpan(absl::Span<const ProtoType> p) : protos(p) {}
+
+  operator absl::Span<const ProtoType>() const noexcept { return protos; }
+};
+
+// type_caster<> implementation for WrappedProtoSpan.
+template <typename ProtoType>
+struct wrapped_proto_span_caster {
+  static constexpr auto name =
+      (pybind11::detail::const_name("Sequence[") +
+       pybind11::detail::const_name<ProtoType>() +
+       pybind11::detail::const_name("]"));
+
+  // cast converts from Python -> C++
+  bool load(pybind11::handle src, bool convert) {
+    using load_impl = pybind11_protobuf::proto_caster_load_impl<ProtoType>;
+
+    if (!IsProtoSequence(src)) {
+      return false;
+    }
+    auto s = pybind11::reinterpret_borrow<pybind11::sequence>(src);
+    value.storage.clear();
+    value.storage.reserve(s.size());
+    for (auto it : s) {
+      value.storage.emplace_back();
+      if (!load_impl::load_into(it, convert, &value.storage.back())) {
+        return false;
+      }
+    }
+    value.protos = value.storage;
+    return true;
+  }
+
+  // cast converts from C++ -> Python
+  static pybind11::handle cast(WrappedProtoSpan<ProtoType> src,
+                               pybind11::return_value_policy policy,
+                               pybind11::handle parent) {
+    return wrapped_proto_list_cast(src.protos, parent);
+  }
+
+  explicit operator WrappedProtoSpan<ProtoType>&&() && {
+    return std::move(value);
+  }
+
+  template <typename T_>
+  using cast_op_type = WrappedProtoSpan<ProtoType>&&;
+
+  WrappedProtoSpan<ProtoType> value;
+};
+
+/// WrappedProtoArray<T, N> wraps a std::array<T, N>. Loading requires a
+/// Python sequence of exactly N messages.
+template <typename ProtoType, size_t N>
+struct WrappedProtoArray {
+  std::array<ProtoType, N> protos;
+
+  WrappedProtoArray() = default;
+
+  WrappedProtoArray(std::array<ProtoType, N>&& p) : protos(std::move(p)) {}
+  WrappedProtoArray(const std::array<ProtoType, N>& p) : protos(p) {}
+
+  operator std::array<ProtoType, N>&&() && noexcept {
+    return std::move(protos);
+  }
+};
+
+// type_caster<> implementation for WrappedProtoArray. See
+// pybind11::array_caster.
+template <typename ProtoType, size_t N>
+struct wrapped_proto_array_caster {
+  static constexpr auto name =
+      (pybind11::detail::const_name("List[") +
+       pybind11::detail::const_name<ProtoType>() +
+       pybind11::detail::const_name("[") + pybind11::detail::const_name<N>() +
+       pybind11::detail::const_name("]]"));
+
+  // cast converts from Python -> C++
+  bool load(pybind11::handle src, bool convert) {
+    using load_impl = pybind11_protobuf::proto_caster_load_impl<ProtoType>;
+
+    if (!IsProtoSequence(src)) {
+      return false;
+    }
+    auto s = pybind11::reinterpret_borrow<pybind11::sequence>(src);
+    if (s.size() != N) {
+      return false;
+    }
+    size_t index = 0;
+    for (auto it : s) {
+      if (!load_impl::load_into(it, convert, &value.protos[index++])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // cast converts from C++ -> Python
+  static pybind11::handle cast(WrappedProtoArray<ProtoType, N> src,
+                               pybind11::return_value_policy policy,
+                               pybind11::handle parent) {
+    return wrapped_proto_list_cast(src.protos, parent);
+  }
+
+  explicit operator WrappedProtoArray<ProtoType, N>&&() && {
+    return std::move(value);
+  }
+
+  template <typename T_>
+  using cast_op_type = WrappedProtoArray<ProtoType, N>&&;
+
+  WrappedProtoArray<ProtoType, N> value;
+};
+
+/// WrappedProtoMap<M> wraps a std::map or absl::flat_hash_map with proto
+/// values. Keys are converted with their regular pybind11 type_caster<>.
+template <typename MapType>
+struct WrappedProtoMap {
+  MapType protos;
+
+  WrappedProtoMap() = default;
+
+  WrappedProtoMap(MapType&& p) : protos(std::move(p)) {}
+  WrappedProtoMap(const MapType& p) : protos(p) {}
+
+  operator MapType&&() && noexcept { return std::move(protos); }
+};
+
+// type_caster<> implementation for WrappedProtoMap. See
+// pybind11::map_caster.
+template <typename MapType>
+struct wrapped_proto_map_caster {
+  using Key = typename MapType::key_type;
+  using ProtoType = typename MapType::mapped_type;
+  using key_caster = pybind11::detail::make_caster<Key>;
+
+  static constexpr auto name =
+      (pybind11::detail::const_name("Dict[") + key_caster::name +
+       pybind11::detail::const_name(", ") +
+       pybind11::detail::const_name<ProtoType>() +
+       pybind11::detail::const_name("]"));
+
+  // cast converts from Python -> C++
+  bool load(pybind11::handle src, bool convert) {
+    using load_impl = pybind11_protobuf::proto_caster_load_impl<ProtoType>;
+
+    if (!pybind11::isinstance<pybind11::dict>(src)) {
+      return false;
+    }
+    auto d = pybind11::reinterpret_borrow<pybind11::dict>(src);
+    value.protos.clear();
+    for (auto it : d) {
+      key_caster kconv;
+      if (!kconv.load(it.first.ptr(), convert)) {
+        return false;
+      }
+      // Load each value directly into its map slot.
+      auto result = value.protos.try_emplace(
+          pybind11::detail::cast_op<Key&&>(std::move(kconv)));
+      if (!load_impl::load_into(it.second, convert, &result.first->second)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // cast converts from C++ -> Python
+  static pybind11::handle cast(WrappedProtoMap<MapType> src,
+                               pybind11::return_value_policy policy,
+                               pybind11::handle parent) {
+    pybind11::dict d;
+    for (auto&& kv : src.protos) {
+      auto key = pybind11::reinterpret_steal<pybind11::object>(
+          key_caster::cast(
+              kv.first,
+              pybind11::detail::return_value_policy_override<Key>::policy(
+                  policy),
+              parent));
       auto value_ = pybind11::reinterpret_steal<pybind11::object>(
           pybind11_protobuf::native_cast_impl::cast_impl(
-              &value, pybind11::return_value_policy::move, parent,
+              &kv.second, pybind11::return_value_policy::move, parent,
               /*is_const*/ false));
-      if (!value_) {
+      if (!key || !value_) {
         return pybind11::handle();
       }
-      PyList_SET_ITEM(l.ptr(), index++,
-                      value_.release().ptr());  // steals a reference
+      d[std::move(key)] = std::move(value_);
     }
-    return l.release();
+    return d.release();
   }
 
-  explicit operator WrappedProtoVector<ProtoType>&&() && {
+  explicit operator WrappedProtoMap<MapType>&&() && {
     return std::move(value);
   }
 
   template <typename T_>
-  using cast_op_type = WrappedProtoVector<ProtoType>&&;
+  using cast_op_type = WrappedProtoMap<MapType>&&;
 
-  WrappedProtoVector<ProtoType> value;
+  WrappedProtoMap<MapType> value;
 };
 
 // Implementation details for WithWrappedProtos
@@ -389,6 +656,61 @@ struct WrapHelper<const std::vector<ProtoType>&,  //
   using type = WrappedProtoVector<ProtoType>;
 };
 
+// absl::Span<const Proto> is rewritten to WrappedProtoSpan<Proto>.
+template <typename ProtoType>
+struct WrapHelper<absl::Span<const ProtoType>,  //
+                  std::enable_if_t<std::is_base_of<
+                      ::google::protobuf::Message, ProtoType>::value>> {
+  using type = WrappedProtoSpan<ProtoType>;
+};
+template <typename ProtoType>
+struct WrapHelper<const absl::Span<const ProtoType>&,  //
+                  std::enable_if_t<std::is_base_of<
+                      ::google::protobuf::Message, ProtoType>::value>> {
+  using type = WrappedProtoSpan<ProtoType>;
+};
+
+// std::array<Proto, N> is rewritten to WrappedProtoArray<Proto, N>.
+template <typename ProtoType, size_t N>
+struct WrapHelper<std::array<ProtoType, N>,  //
+                  std::enable_if_t<std::is_base_of<
+                      ::google::protobuf::Message, intrinsic_t<ProtoType>>::value>> {
+  using type = WrappedProtoArray<ProtoType, N>;
+};
+template <typename ProtoType, size_t N>
+struct WrapHelper<const std::array<ProtoType, N>&,  //
+                  std::enable_if_t<std::is_base_of<
+                      ::google::protobuf::Message, intrinsic_t<ProtoType>>::value>> {
+  using type = WrappedProtoArray<ProtoType, N>;
+};
+
+// std::map<K, Proto> and absl::flat_hash_map<K, Proto> are rewritten to
+// WrappedProtoMap<>.
+template <typename Key, typename ProtoType>
+struct WrapHelper<std::map<Key, ProtoType>,  //
+                  std::enable_if_t<std::is_base_of<
+                      ::google::protobuf::Message, intrinsic_t<ProtoType>>::value>> {
+  using type = WrappedProtoMap<std::map<Key, ProtoType>>;
+};
+template <typename Key, typename ProtoType>
+struct WrapHelper<const std::map<Key, ProtoType>&,  //
+                  std::enable_if_t<std::is_base_of<
+                      ::google::protobuf::Message, intrinsic_t<ProtoType>>::value>> {
+  using type = WrappedProtoMap<std::map<Key, ProtoType>>;
+};
+template <typename Key, typename ProtoType>
+struct WrapHelper<absl::flat_hash_map<Key, ProtoType>,  //
+                  std::enable_if_t<std::is_base_of<
+                      ::google::protobuf::Message, intrinsic_t<ProtoType>>::value>> {
+  using type = WrappedProtoMap<absl::flat_hash_map<Key, ProtoType>>;
+};
+template <typename Key, typename ProtoType>
+struct WrapHelper<const absl::flat_hash_map<Key, ProtoType>&,  //
+                  std::enable_if_t<std::is_base_of<
+                      ::google::protobuf::Message, intrinsic_t<ProtoType>>::value>> {
+  using type = WrappedProtoMap<absl::flat_hash_map<Key, ProtoType>>;
+};
+
 // And absl::StatusOr<std::vector<Proto>>
 template <typename ProtoType>
 struct WrapHelper<absl::StatusOr<std::vector<ProtoType>>,  //
@@ -508,6 +830,28 @@ struct type_caster<
     std::enable_if_t<std::is_base_of<::google::protobuf::Message, ProtoType>::value>>
     : public pybind11_protobuf::wrapped_proto_vector_caster<ProtoType> {};
 
+// pybind11 type_caster<> specialization for WrappedProtoSpan<proto>.
+template <typename ProtoType>
+struct type_caster<
+    pybind11_protobuf::WrappedProtoSpan<ProtoType>,
+    std::enable_if_t<std::is_base_of<::google::protobuf::Message, ProtoType>::value>>
+    : public pybind11_protobuf::wrapped_proto_span_caster<ProtoType> {};
+
+// pybind11 type_caster<> specialization for WrappedProtoArray<proto, N>.
+template <typename ProtoType, size_t N>
+struct type_caster<
+    pybind11_protobuf::WrappedProtoArray<ProtoType, N>,
+    std::enable_if_t<std::is_base_of<::google::protobuf::Message, ProtoType>::value>>
+    : public pybind11_protobuf::wrapped_proto_array_caster<ProtoType, N> {};
+
+// pybind11 type_caster<> specialization for WrappedProtoMap<map>.
+template <typename MapType>
+struct type_caster<
+    pybind11_protobuf::WrappedProtoMap<MapType>,
+    std::enable_if_t<std::is_base_of<::google::protobuf::Message,
+                                     typename MapType::mapped_type>::value>>
+    : public pybind11_protobuf::wrapped_proto_map_caster<MapType> {};
+
 }  // namespace detail
 }  // namespace pybind11
 